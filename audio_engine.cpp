@@ -0,0 +1,97 @@
+#include "audio_engine.h"
+
+#include <cmath>
+
+// classic buzzer tone
+static const double square_hz = 440;
+// peak amplitude, well below full scale
+static const float volume = 0.2f;
+// attack and release, 2 ms from silence to full volume
+static const float ramp_step = volume / (AudioEngine::sample_rate / 500);
+// device buffer, bounds queued audio to about 5 ms
+static const char* device_frames = "256";
+
+AudioEngine::AudioEngine()
+    : stream(NULL), gate(false), pattern{}, pitch(64), busyNs(0),
+      phase(0), level(0) {
+}
+
+bool AudioEngine::open() {
+    SDL_SetHint(SDL_HINT_AUDIO_DEVICE_SAMPLE_FRAMES, device_frames);
+    SDL_AudioSpec spec = { SDL_AUDIO_F32, 1, sample_rate };
+    stream = SDL_OpenAudioDeviceStream(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK,
+        &spec, feed, this);
+    if (stream == NULL) {
+        SDL_Log("Couldn't create audio stream: %s", SDL_GetError());
+        return false;
+    }
+    // the callback runs from now on, writing silence while the gate is shut
+    SDL_ResumeAudioStreamDevice(stream);
+    return true;
+}
+
+void AudioEngine::close() {
+    // stops the callback before the engine goes away
+    SDL_DestroyAudioStream(stream);
+    stream = NULL;
+}
+
+void AudioEngine::update(bool on, const std::array<uint8_t, 16>& bytes,
+        uint8_t pitchRegister) {
+    uint64_t words[2] = { 0, 0 };
+    for (int i = 0; i < 16; i++) {
+        words[i / 8] = words[i / 8] << 8 | bytes[i];
+    }
+    pattern[0].store(words[0], std::memory_order_relaxed);
+    pattern[1].store(words[1], std::memory_order_relaxed);
+    pitch.store(pitchRegister, std::memory_order_relaxed);
+    gate.store(on, std::memory_order_relaxed);
+}
+
+void SDLCALL AudioEngine::feed(void* userdata, SDL_AudioStream* stream,
+        int additional, int total) {
+    AudioEngine* engine = (AudioEngine*)userdata;
+    Uint64 start = SDL_GetTicksNS();
+    int samples = additional / (int)sizeof(float);
+    while (samples > 0) {
+        int n = samples < chunk_samples ? samples : chunk_samples;
+        engine->generate(engine->buffer, n);
+        SDL_PutAudioStreamData(stream, engine->buffer, n * sizeof(float));
+        samples -= n;
+    }
+    engine->busyNs.fetch_add(SDL_GetTicksNS() - start,
+        std::memory_order_relaxed);
+}
+
+void AudioEngine::generate(float* out, int samples) {
+    bool on = gate.load(std::memory_order_relaxed);
+    uint64_t words[2] = { pattern[0].load(std::memory_order_relaxed),
+        pattern[1].load(std::memory_order_relaxed) };
+    // an all-zero pattern means the program never set one: plain buzzer
+    bool square = (words[0] | words[1]) == 0;
+    // XO-CHIP plays 4000 pattern bits per second at pitch 64, an octave
+    // per 48 steps
+    double step = square ? square_hz / sample_rate
+        : 4000 * std::exp2((pitch.load(std::memory_order_relaxed) - 64)
+            / 48.0) / sample_rate;
+    double period = square ? 1 : 128;
+    if (phase >= period) phase = std::fmod(phase, period);
+
+    for (int i = 0; i < samples; i++) {
+        if (on && level < volume) {
+            level = std::fmin(level + ramp_step, volume);
+        } else if (!on && level > 0) {
+            level = std::fmax(level - ramp_step, 0.0f);
+        }
+        bool high;
+        if (square) {
+            high = phase < 0.5;
+        } else {
+            int bit = (int)phase;
+            high = (words[bit >> 6] >> (63 - (bit & 63))) & 1;
+        }
+        out[i] = high ? level : -level;
+        phase += step;
+        if (phase >= period) phase -= period;
+    }
+}
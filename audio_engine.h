@@ -0,0 +1,58 @@
+#ifndef AUDIO_ENGINE_H
+#define AUDIO_ENGINE_H
+
+#include <SDL3/SDL.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Synthesizes the buzzer in SDL's audio callback: a square wave, or the
+// XO-CHIP 128-bit pattern at the pitch register's rate once a program has
+// loaded one. Samples are generated on demand into a preallocated buffer,
+// so the queue never holds more than the device asks for. Phase carries
+// over between callbacks and the tone fades in and out over a couple of
+// milliseconds, so starting or stopping never clicks.
+class AudioEngine {
+public:
+    static const int sample_rate = 48000;
+
+    AudioEngine();
+    ~AudioEngine() { close(); }
+
+    // open the default playback device, false on failure
+    bool open();
+    void close();
+
+    // sound state for the coming samples, from the emulation thread
+    void update(bool on, const std::array<uint8_t, 16>& pattern,
+        uint8_t pitch);
+
+    // nanoseconds spent generating samples since the last call
+    uint64_t takeBusyTime() {
+        return busyNs.exchange(0, std::memory_order_relaxed);
+    }
+
+private:
+    static const int chunk_samples = 512;
+
+    static void SDLCALL feed(void* userdata, SDL_AudioStream* stream,
+        int additional, int total);
+    void generate(float* out, int samples);
+
+    SDL_AudioStream* stream;
+    float buffer[chunk_samples];
+
+    // written by update(), read by the callback
+    std::atomic<bool> gate;
+    std::atomic<uint64_t> pattern[2];
+    std::atomic<uint8_t> pitch;
+    std::atomic<uint64_t> busyNs;
+
+    // callback only: position in the waveform, 0-1 (square) or 0-128
+    // (pattern bits), and the current envelope level
+    double phase;
+    float level;
+};
+
+#endif
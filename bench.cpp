@@ -0,0 +1,239 @@
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "chip8.h"
+#include "multi_host.h"
+
+// Micro-benchmarks for the interpreter hot paths. Each workload runs on
+// every dispatch engine and reports time per Chip-8 instruction; extra
+// command line arguments are ROM files benchmarked the same way.
+//
+//   chip-8-bench [--benchmark_out=results.json] [rom ...]
+
+namespace {
+
+struct EngineName {
+    Chip8::Engine engine;
+    const char* name;
+};
+
+const EngineName engines[] = {
+    { Chip8::Engine::Table, "table" },
+    { Chip8::Engine::Threaded, "threaded" },
+    { Chip8::Engine::Blocks, "blocks" },
+};
+
+// XOR a 15-row sprite across the screen, moving diagonally
+const std::vector<Byte> draw_program = {
+    0xA2, 0x20, // I = sprite
+    0x60, 0x00, // V0 = 0
+    0x61, 0x00, // V1 = 0
+    0xD0, 0x1F, // draw 15 rows at V0, V1
+    0x70, 0x07, // V0 += 7
+    0x71, 0x03, // V1 += 3
+    0x12, 0x06, // loop
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    // sprite at 0x220
+    0xFF, 0x81, 0xBD, 0xA5, 0xA5, 0xBD, 0x81, 0xFF,
+    0x3C, 0x42, 0x99, 0xA5, 0x99, 0x42, 0x3C,
+};
+
+// every 8XYN arithmetic and logic op in a tight loop
+const std::vector<Byte> alu_program = {
+    0x60, 0x37, // V0 = 0x37
+    0x61, 0x5A, // V1 = 0x5A
+    0x80, 0x14, // V0 += V1
+    0x81, 0x05, // V1 -= V0
+    0x82, 0x01, // V2 |= V0
+    0x83, 0x12, // V3 &= V1
+    0x84, 0x23, // V4 ^= V2
+    0x85, 0x06, // V5 = V0 >> 1
+    0x86, 0x0E, // V6 = V0 << 1
+    0x87, 0x07, // V7 = V0 - V7
+    0x88, 0x10, // V8 = V1
+    0x12, 0x04, // loop
+};
+
+// BCD conversion and register block stores / loads
+const std::vector<Byte> memory_program = {
+    0xA3, 0x00, // I = 0x300
+    0xF0, 0x33, // BCD of V0
+    0xA3, 0x10, // I = 0x310
+    0xFF, 0x55, // store V0 - VF
+    0xA3, 0x10, // I = 0x310
+    0xFF, 0x65, // load V0 - VF
+    0x70, 0x01, // V0 += 1
+    0x12, 0x00, // loop
+};
+
+void setUp(benchmark::State& state, Chip8& chip8, Chip8::Engine engine,
+        const std::vector<Byte>& program) {
+    chip8.engine = engine;
+    chip8.seed(1);
+    if (chip8.loadProgram(program.data(), program.size()) != 0) {
+        state.SkipWithError("program could not be loaded");
+    }
+}
+
+void reportInstructions(benchmark::State& state, int64_t instructions) {
+    state.SetItemsProcessed(instructions);
+    // inverted rate, printed as time per instruction
+    state.counters["time/instr"] = benchmark::Counter(instructions,
+        benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+// whole frames of the given program
+void runProgram(benchmark::State& state, Chip8::Engine engine,
+        std::vector<Byte> program) {
+    Chip8 chip8;
+    setUp(state, chip8, engine, program);
+    for (auto _ : state) {
+        chip8.runFrame();
+        benchmark::DoNotOptimize(chip8.registers);
+    }
+    int64_t frames = state.iterations();
+    reportInstructions(state, frames * chip8.instructionsPerFrame);
+    state.counters["fps"] = benchmark::Counter(frames,
+        benchmark::Counter::kIsRate);
+}
+
+// a frame of the draw loop plus unpacking the screen to texture pixels,
+// the work the front end does every frame
+void renderFrame(benchmark::State& state, Chip8::Engine engine) {
+    Chip8 chip8;
+    setUp(state, chip8, engine, draw_program);
+    std::vector<uint32_t> texture(Framebuffer::max_width
+        * Framebuffer::max_height);
+    uint32_t palette[16] = { 0xFF000000, 0xFFFFFFFF };
+    for (auto _ : state) {
+        chip8.runFrame();
+        chip8.pixels.expand(texture.data(),
+            Framebuffer::max_width * sizeof(uint32_t), palette);
+        benchmark::DoNotOptimize(texture.data());
+        benchmark::ClobberMemory();
+    }
+    int64_t frames = state.iterations();
+    reportInstructions(state, frames * chip8.instructionsPerFrame);
+    state.counters["fps"] = benchmark::Counter(frames,
+        benchmark::Counter::kIsRate);
+}
+
+// a frame of the draw loop on every instance of a MultiHost
+void hostFrame(benchmark::State& state) {
+    int instances = state.range(0);
+    MultiHost host(instances);
+    for (int i = 0; i < instances; i++) {
+        if (host.load(i, draw_program.data(), draw_program.size()) != 0) {
+            state.SkipWithError("program could not be loaded");
+            return;
+        }
+    }
+    for (auto _ : state) {
+        host.runFrame();
+    }
+    int64_t frames = state.iterations() * instances;
+    reportInstructions(state, frames * host.instructionsPerFrame);
+    state.counters["fps"] = benchmark::Counter(frames,
+        benchmark::Counter::kIsRate);
+}
+
+// opcode -> instruction class for every opcode
+void decodeAll(benchmark::State& state) {
+    for (auto _ : state) {
+        for (int opcode = 0; opcode < 0x10000; opcode++) {
+            benchmark::DoNotOptimize(decodeOpcode(opcode,
+                Extensions::XoChip));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * 0x10000);
+}
+
+void clearScreen(benchmark::State& state) {
+    Framebuffer pixels;
+    for (auto _ : state) {
+        pixels.clear();
+        benchmark::ClobberMemory();
+    }
+}
+
+void loadFont(benchmark::State& state) {
+    Chip8 chip8;
+    for (auto _ : state) {
+        chip8.loadFont();
+        benchmark::ClobberMemory();
+    }
+}
+
+void loadProgram(benchmark::State& state, std::string path) {
+    Chip8 chip8;
+    for (auto _ : state) {
+        if (chip8.loadProgram(path.c_str()) != 0) {
+            state.SkipWithError("program could not be loaded");
+            break;
+        }
+    }
+}
+
+int readFile(const char* path, std::vector<Byte>& data) {
+    std::ifstream file {path, std::ios::binary};
+    if (!file) {
+        std::fprintf(stderr, "ROM %s could not be opened.\n", path);
+        return 1;
+    }
+    data.assign(std::istreambuf_iterator<char>(file),
+        std::istreambuf_iterator<char>());
+    return 0;
+}
+
+}
+
+int main(int argc, char* args[]) {
+    benchmark::Initialize(&argc, args);
+
+    benchmark::RegisterBenchmark("decode", decodeAll);
+    benchmark::RegisterBenchmark("clearScreen", clearScreen);
+    benchmark::RegisterBenchmark("loadFont", loadFont);
+    benchmark::RegisterBenchmark("hostFrame", hostFrame)
+        ->Arg(64)->Arg(1024)->Arg(4096)->UseRealTime();
+
+    for (const EngineName& e : engines) {
+        std::string suffix = std::string("/") + e.name;
+        benchmark::RegisterBenchmark(("draw" + suffix).c_str(),
+            runProgram, e.engine, draw_program);
+        benchmark::RegisterBenchmark(("alu" + suffix).c_str(),
+            runProgram, e.engine, alu_program);
+        benchmark::RegisterBenchmark(("bcdStore" + suffix).c_str(),
+            runProgram, e.engine, memory_program);
+        benchmark::RegisterBenchmark(("frameRender" + suffix).c_str(),
+            renderFrame, e.engine);
+    }
+
+    // ROMs left over after the benchmark flags
+    for (int i = 1; i < argc; i++) {
+        if (args[i][0] == '-') {
+            std::fprintf(stderr, "Unknown option %s.\n", args[i]);
+            return 1;
+        }
+        std::vector<Byte> rom;
+        if (readFile(args[i], rom) != 0) {
+            return 1;
+        }
+        std::string name = std::string("rom:") + args[i];
+        benchmark::RegisterBenchmark(("loadProgram/" + name).c_str(),
+            loadProgram, std::string(args[i]));
+        for (const EngineName& e : engines) {
+            benchmark::RegisterBenchmark((name + "/" + e.name).c_str(),
+                runProgram, e.engine, rom);
+        }
+    }
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,128 @@
+#ifndef BLOCK_CACHE_H
+#define BLOCK_CACHE_H
+
+#include <cstdint>
+#include <vector>
+
+#include "opcodes.h"
+
+// One step of a translated block: an instruction, or a 6XNN / 7XNN chain
+// on one register folded into a single 6XNN or 7XNN with the summed
+// constant. Loop jumps folded away count towards the step after them.
+struct BlockOp {
+    // opClass of the marker that ends a run through a block's ops
+    static const uint8_t stop = OP_COUNT;
+
+    uint8_t opClass;
+    // Chip-8 instructions this step stands for
+    uint8_t length;
+    // instructions in the block before this step
+    uint8_t before;
+    uint16_t opcode;
+    // address of the first instruction it stands for
+    uint16_t address;
+};
+
+// Straight-line run of instructions ending at the first forward jump,
+// skip, call, return or key wait. A jump back into the block unrolls the
+// loop instead, so translation carries on at its target. Memory writes
+// inside it are checked as they run.
+struct Block {
+    // longest run translated in one go; instructions are unique within
+    // [start, end), so a block spans at most 2 * max_instructions bytes
+    static const int max_instructions = 32;
+
+    uint16_t start;
+    // one past the last byte covered
+    uint16_t end;
+    // pc after the last instruction
+    uint16_t exit;
+    // Chip-8 instructions covered
+    int instructions;
+    int opCount;
+    bool live;
+    // slots of the last two blocks run after this one, -1 if none; only
+    // hints, checked against start and live before use
+    int next[2];
+    // fused ops never outnumber instructions, plus a stop marker
+    BlockOp ops[max_instructions + 1];
+    // op each instruction of the block belongs to, to find where a
+    // budget runs out
+    uint8_t opOf[max_instructions];
+};
+
+// Translated blocks keyed by start address. Tracks which RAM bytes are
+// covered by live blocks so writes into code can invalidate them; the
+// slots of invalidated blocks are reused by the next ones translated.
+class BlockCache {
+public:
+    static const int ram_size = 65536;
+    // past this many live blocks, everything is flushed (by the caller,
+    // which may hold slot numbers)
+    static const int max_blocks = 4096;
+    // codePages granularity, 64-byte pages
+    static const int page_bits = 6;
+
+    BlockCache() : live(0) {}
+
+    bool empty() const { return live == 0; }
+    bool full() const { return live >= max_blocks; }
+
+    // slot of the block starting at address, -1 if not translated yet
+    int find(uint16_t address) const {
+        return index.empty() ? -1 : index[address];
+    }
+    Block& operator[](int i) { return blocks[i]; }
+
+    // slot of the block at address if from has run into it before, -1
+    // if not
+    int successor(int from, uint16_t address) const {
+        for (int i : blocks[from].next) {
+            if (i >= 0 && blocks[i].live && blocks[i].start == address) {
+                return i;
+            }
+        }
+        return -1;
+    }
+    // quick test before invalidate for a write of up to 64 bytes at
+    // address: false if no live block is within the write's pages
+    bool nearCode(int address) const {
+        int page = address >> page_bits;
+        return !codePages.empty()
+            && (codePages[page] | codePages[page + 1]) != 0;
+    }
+
+    // remember that to ran after from
+    void link(int from, int to) {
+        int* next = blocks[from].next;
+        next[1] = next[0];
+        next[0] = to;
+    }
+
+    // add a translated block made of the given ops, returns its slot
+    int insert(uint16_t start, uint16_t end, uint16_t exit,
+            int instructions, const std::vector<BlockOp>& blockOps);
+
+    // drop blocks covering any byte in [address, address + length)
+    void invalidate(int address, int length);
+
+    // drop everything (e.g. RAM was replaced)
+    void clear();
+
+private:
+    void remove(int i);
+
+    // block slots, dead ones are listed in freeSlots
+    std::vector<Block> blocks;
+    std::vector<int> freeSlots;
+    int live;
+    // block index by start address, -1 if none; allocated with the first
+    // block
+    std::vector<int> index;
+    // number of live blocks covering each RAM byte
+    std::vector<uint8_t> codeRefs;
+    // number of live blocks in each page, plus a blank page past the end
+    std::vector<uint16_t> codePages;
+};
+
+#endif
@@ -0,0 +1,184 @@
+#include "chip8.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "font.h"
+
+Chip8::Chip8()
+    : ram(), pc(0x200), i_reg(0), stack(), sp(0),
+      registers(), dTimer(0), sTimer(0),
+      pixels(screen_width, screen_height),
+      flags(), audioPattern(), pitch(64), keys(), lastKey(-1), programSize(0),
+      mt(std::chrono::steady_clock::now().time_since_epoch().count()),
+      engine(Engine::Threaded), instructionsPerFrame(instructions_per_frame),
+      profile(QuirkProfile::CosmacVip),
+#if CHIP8_PROFILER
+      profiler(nullptr),
+#endif
+      debugger(nullptr),
+      blocksProfile(QuirkProfile::CosmacVip) {
+}
+
+// store the built-in font (050-09F) and big font (0A0-13F)
+void Chip8::loadFont() {
+    blocks.clear();
+    std::memcpy(&ram[font_address], font_data, sizeof(font_data));
+    std::memcpy(&ram[big_font_address], big_font_data, 
+        sizeof(big_font_data));
+}
+
+// replace the fonts from a file of hex bytes: 80 for the font, then up to
+// 160 for the big font; anything not given keeps the built-in glyphs
+int Chip8::loadFont(const char* path) {
+    std::ifstream file {path};
+    if(!file) {
+        std::cerr << "Font file could not be opened.\n";
+        return 1;
+    }
+
+    Byte data[sizeof(font_data) + sizeof(big_font_data)];
+    std::memcpy(data, font_data, sizeof(font_data));
+    std::memcpy(data + sizeof(font_data), big_font_data, 
+        sizeof(big_font_data));
+    std::string token;
+    size_t i = 0;
+    while (file >> token) {
+        char* end;
+        long value = std::strtol(token.c_str(), &end, 16);
+        if (*end != '\0' || value < 0 || value > 0xFF 
+                || i == sizeof(data)) {
+            std::cerr << "Font file is not a list of up to 240 hex bytes.\n";
+            return 1;
+        }
+        data[i++] = value;
+    }
+
+    blocks.clear();
+    std::memcpy(&ram[font_address], data, sizeof(font_data));
+    std::memcpy(&ram[big_font_address], data + sizeof(font_data), 
+        sizeof(big_font_data));
+    return 0;
+}
+
+// read a program file in one call
+int Chip8::readProgram(const char* path, std::vector<Byte>& data) {
+    std::ifstream programFile {path, std::ios::binary | std::ios::ate};
+    if(!programFile) {
+        std::cerr << "Program file could not be opened.\n";
+        return 1;
+    }
+    std::streamoff size = programFile.tellg();
+    if (size < 0 || size > 0x10000) {
+        std::cerr << "Program is too large.\n";
+        return 1;
+    }
+    data.resize(size);
+    programFile.seekg(0);
+    if (!programFile.read((char*)data.data(), size)) {
+        std::cerr << "Program file could not be read.\n";
+        return 1;
+    }
+    return 0;
+}
+
+// load program into memory at 0x200
+int Chip8::loadProgram(const char* path) {
+    std::vector<Byte> data;
+    if (readProgram(path, data) != 0) {
+        return 1;
+    }
+    return loadProgram(data.data(), data.size());
+}
+
+int Chip8::maxProgramSize() const {
+    return memorySize() - 0x200;
+}
+
+int Chip8::loadProgram(const Byte* data, int size) {
+    if (size < 0 || size > maxProgramSize()) {
+        std::cerr << "Program is too large.\n";
+        return 1;
+    }
+    blocks.clear();
+    std::copy(data, data + size, ram.begin() + 0x200);
+    programSize = size;
+    return 0;
+}
+
+void Chip8::updateTimers() {
+    if (dTimer > 0) dTimer--;
+    if (sTimer > 0) sTimer--;
+}
+
+void Chip8::runFrame() {
+    run(instructionsPerFrame);
+    // a debugger stop freezes the timers along with the CPU
+    if (debugger != nullptr && debugger->paused()) {
+        return;
+    }
+    updateTimers();
+#if CHIP8_PROFILER
+    if (profiler != nullptr) {
+        profiler->endFrame();
+    }
+#endif
+}
+
+uint16_t Chip8::keyMask() const {
+    uint16_t mask = 0;
+    for (int i = 0; i < 16; i++) {
+        mask |= keys[i] << i;
+    }
+    return mask;
+}
+
+void Chip8::setKeyMask(uint16_t mask) {
+    for (int i = 0; i < 16; i++) {
+        keys[i] = (mask >> i) & 1;
+    }
+}
+
+uint64_t Chip8::framebufferHash() const {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (int p = 0; p < Framebuffer::max_planes; p++) {
+        // blank extra planes are skipped so single-plane hashes stay the
+        // same as before XO-CHIP support
+        bool blank = true;
+        for (int y = 0; y < pixels.height && blank; y++) {
+            blank = (pixels.planes[p][y][0] | pixels.planes[p][y][1]) == 0;
+        }
+        if (p > 0 && blank) {
+            continue;
+        }
+        for (int y = 0; y < pixels.height; y++) {
+            for (int w = 0; w < Framebuffer::words_per_row; w++) {
+                uint64_t word = pixels.planes[p][y][w];
+                for (int b = 0; b < 8; b++) {
+                    hash ^= (word >> (8 * b)) & 0xFF;
+                    hash *= 0x100000001b3ULL;
+                }
+            }
+        }
+    }
+    return hash;
+}
+
+uint64_t Chip8::programHash() const {
+    int size = std::min<int>(programSize, ram.size() - 0x200);
+    return hashProgram(&ram[0x200], size);
+}
+
+uint64_t Chip8::hashProgram(const Byte* data, int size) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (int i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
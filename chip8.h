@@ -0,0 +1,165 @@
+#ifndef CHIP8_H
+#define CHIP8_H
+
+#include <array>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "block_cache.h"
+#include "debugger.h"
+#include "framebuffer.h"
+#include "opcodes.h"
+#include "profiler.h"
+#include "quirks.h"
+
+using Byte = uint8_t;
+using Nibble = Byte;
+using TwoByte = uint16_t;
+
+struct Snapshot;
+
+// Chip-8 machine state and interpreter, independent of any front end.
+class Chip8 {
+public:
+    // instruction dispatch strategies, selectable at runtime
+    enum class Engine {
+        // 64K-entry table of handler pointers, indexed by opcode
+        Table,
+        // opcode -> class table plus computed goto (switch if unsupported)
+        Threaded,
+        // straight-line blocks translated once and cached by address
+        Blocks
+    };
+
+    // screen dimensions
+    static const int screen_width = 64;
+    static const int screen_height = 32;
+    // default instructions executed per 60Hz frame
+    static const int instructions_per_frame = 15;
+    // 5-byte hex digits (050-09F) and 10-byte big digits (0A0-13F)
+    static const int font_address = 0x50;
+    static const int big_font_address = 0xA0;
+
+    Chip8();
+
+    // store the built-in font (050-09F) and big font (0A0-13F)
+    void loadFont();
+    // replace them from a file of up to 240 hex bytes (font, then big font)
+    int loadFont(const char* path);
+    // read a program file whole, without loading it
+    static int readProgram(const char* path, std::vector<Byte>& data);
+    // load program into memory at 0x200
+    int loadProgram(const char* path);
+    // copy an in-memory program to 0x200
+    int loadProgram(const Byte* data, int size);
+    // largest program for the quirk profile: 3584 bytes up to 0xFFF,
+    // the rest of the 64 kB for XO-CHIP
+    int maxProgramSize() const;
+    // RAM the profile addresses (memorySizeOf), the rest of ram is unused
+    int memorySize() const { return memorySizeOf(profile); }
+
+    // fetch, decode and execute a single instruction
+    void step();
+    // execute count instructions with the selected engine
+    void run(int count);
+    // decrement delay and sound timers, called at 60Hz
+    void updateTimers();
+    // execute instructionsPerFrame instructions, then update timers
+    void runFrame();
+
+    // copy the full machine state out / back in, without allocating
+    void save(Snapshot& snapshot) const;
+    void restore(const Snapshot& snapshot);
+
+    // reseed the PRNG used by CXNN, for reproducible runs
+    void seed(uint32_t value) { mt.seed(value); }
+
+    // key state as a bitmask, bit n set while key n is held
+    uint16_t keyMask() const;
+    void setKeyMask(uint16_t mask);
+
+    // FNV-1a hash of the packed framebuffer rows
+    uint64_t framebufferHash() const;
+    // FNV-1a hash of the loaded program
+    uint64_t programHash() const;
+    static uint64_t hashProgram(const Byte* data, int size);
+
+    // room for XO-CHIP's 64 kB, other profiles only address the first 4 kB
+    // (program should be loaded at 512 or 0x200)
+    std::array<Byte, 65536> ram;
+    // PC (16-bit, 12-bit actual)
+    TwoByte pc;
+    // 16-bit index register (I)
+    TwoByte i_reg;
+    // 16-bit stack, 16 levels of nesting
+    std::array<TwoByte, 16> stack;
+    // stack pointer, wraps around on overflow / underflow
+    Byte sp;
+    // 16 8-bit variable registers (V0 - VF)
+    std::array<Byte, 16> registers;
+    // Delay and sound timers
+    Byte dTimer;
+    Byte sTimer;
+    // pixels' on / off states
+    Framebuffer pixels;
+    // SUPER-CHIP RPL user flags (FX75 / FX85)
+    std::array<Byte, 16> flags;
+    // XO-CHIP 1-bit audio pattern and its playback pitch
+    std::array<Byte, 16> audioPattern;
+    Byte pitch;
+    // key values
+    std::array<bool, 16> keys;
+    // last key pressed
+    int lastKey;
+    // size of loaded program
+    int programSize;
+    // PRNG engine
+    std::mt19937 mt;
+    // dispatch strategy used by run()
+    Engine engine;
+    // CPU speed, instructions per 60Hz timer tick
+    int instructionsPerFrame;
+    // interpreter quirks, defaults to the original COSMAC VIP behavior
+    QuirkProfile profile;
+#if CHIP8_PROFILER
+    // instrumentation, runs take the counting loop while one is attached
+    Profiler* profiler;
+#endif
+    // set by Debugger::poll while it has breakpoints or stepping to do;
+    // runs then take the checking loop
+    Debugger* debugger;
+
+private:
+    // pc and I wrap at the end of the profile's memory
+    template <QuirkProfile P>
+    TwoByte fetch() {
+        constexpr int mask = memorySizeOf(P) - 1;
+        TwoByte opcode = (ram[pc & mask] << 8) | ram[(pc + 1) & mask];
+        pc += 2;
+        return opcode;
+    }
+
+    // engines specialized for each quirk profile
+    template <QuirkProfile P> void stepAs();
+    template <QuirkProfile P> void runTable(int count);
+    template <QuirkProfile P> void runThreaded(int count);
+#if CHIP8_PROFILER
+    template <QuirkProfile P> void runProfiled(int count);
+#endif
+    template <QuirkProfile P> void runDebugged(int count);
+    template <QuirkProfile P> void runBlocksAs(int count);
+    void runBlocks(int count);
+
+    // translate the block at start, returns its slot
+    int compileBlock(TwoByte start);
+    void checkCodeWrite(OpClass opClass, TwoByte opcode, TwoByte address);
+
+    // translated code for the Blocks engine
+    BlockCache blocks;
+    std::vector<BlockOp> blockScratch;
+    // profile the cached blocks were translated for
+    QuirkProfile blocksProfile;
+};
+
+#endif
@@ -0,0 +1,522 @@
+#ifndef CHIP8_OPS_H
+#define CHIP8_OPS_H
+
+// Instruction semantics, one inline handler per OpClass. Shared by every
+// dispatch engine in the core so behavior is defined in one place. The
+// machine is a template parameter too: Chip8, or MultiHost's view of one
+// instance, which has the same members for the CHIP-8 instructions.
+
+#include <algorithm>
+
+#include "chip8.h"
+
+// computed goto is a GNU extension, engines fall back to a switch
+// elsewhere
+#if !defined(CHIP8_COMPUTED_GOTO)
+#if defined(__GNUC__) || defined(__clang__)
+#define CHIP8_COMPUTED_GOTO 1
+#else
+#define CHIP8_COMPUTED_GOTO 0
+#endif
+#endif
+
+using OpHandler = void (*)(Chip8&, TwoByte);
+
+// every opcode decoded with profile P's extensions, a 64K table built on
+// first use (defined in dispatch.cpp for every profile)
+template <QuirkProfile P>
+const OpClass* opcodeClasses();
+
+// opcode fields
+inline Nibble nibbleX(TwoByte opcode) { return (opcode >> 8) & 0xF; }
+inline Nibble nibbleY(TwoByte opcode) { return (opcode >> 4) & 0xF; }
+inline Nibble nibbleN(TwoByte opcode) { return opcode & 0xF; }
+inline Byte byteNN(TwoByte opcode) { return opcode & 0xFF; }
+inline TwoByte addrNNN(TwoByte opcode) { return opcode & 0xFFF; }
+
+// address wrapped to the profile's memory
+template <QuirkProfile P>
+constexpr int wrapAddress(int address) {
+    return address & (memorySizeOf(P) - 1);
+}
+
+// skip the next instruction, which is 4 bytes long if it is F000 NNNN
+template <QuirkProfile P, class Machine>
+inline void skipNext(Machine& c) {
+    if constexpr (quirksOf(P).extensions == Extensions::XoChip) {
+        bool longLoad = c.ram[wrapAddress<P>(c.pc)] == 0xF0
+            && c.ram[wrapAddress<P>(c.pc + 1)] == 0x00;
+        c.pc += longLoad ? 4 : 2;
+    } else {
+        c.pc += 2;
+    }
+}
+
+template <QuirkProfile P, class Machine>
+inline void opINVALID(Machine&, TwoByte) {
+    // undetermined, ignored
+}
+
+template <QuirkProfile P, class Machine>
+inline void op00E0(Machine& c, TwoByte) {
+    // clear the screen
+    c.pixels.clear();
+}
+
+template <QuirkProfile P, class Machine>
+inline void op00EE(Machine& c, TwoByte) {
+    // return
+    c.sp = (c.sp - 1) & 0xF;
+    c.pc = c.stack[c.sp];
+}
+
+template <QuirkProfile P, class Machine>
+inline void op0NNN(Machine&, TwoByte) {
+    // call machine code routine at NNN, not supported
+}
+
+template <QuirkProfile P, class Machine>
+inline void op00CN(Machine& c, TwoByte opcode) {
+    // scroll down N rows (SUPER-CHIP)
+    c.pixels.scrollDown(nibbleN(opcode));
+}
+
+template <QuirkProfile P, class Machine>
+inline void op00DN(Machine& c, TwoByte opcode) {
+    // scroll up N rows (XO-CHIP)
+    c.pixels.scrollUp(nibbleN(opcode));
+}
+
+template <QuirkProfile P, class Machine>
+inline void op00FB(Machine& c, TwoByte) {
+    // scroll right 4 pixels
+    c.pixels.scrollRight(4);
+}
+
+template <QuirkProfile P, class Machine>
+inline void op00FC(Machine& c, TwoByte) {
+    // scroll left 4 pixels
+    c.pixels.scrollLeft(4);
+}
+
+template <QuirkProfile P, class Machine>
+inline void op00FD(Machine& c, TwoByte) {
+    // exit interpreter, stays on this instruction
+    c.pc -= 2;
+}
+
+template <QuirkProfile P, class Machine>
+inline void op00FE(Machine& c, TwoByte) {
+    // low resolution, 64x32
+    c.pixels.setResolution(Chip8::screen_width, Chip8::screen_height);
+}
+
+template <QuirkProfile P, class Machine>
+inline void op00FF(Machine& c, TwoByte) {
+    // high resolution, 128x64
+    c.pixels.setResolution(Framebuffer::max_width, Framebuffer::max_height);
+}
+
+template <QuirkProfile P, class Machine>
+inline void op1NNN(Machine& c, TwoByte opcode) {
+    // jump (set pc to NNN)
+    c.pc = addrNNN(opcode);
+}
+
+template <QuirkProfile P, class Machine>
+inline void op2NNN(Machine& c, TwoByte opcode) {
+    // calls subroutine at NNN
+    c.stack[c.sp] = c.pc;
+    c.sp = (c.sp + 1) & 0xF;
+    c.pc = addrNNN(opcode);
+}
+
+template <QuirkProfile P, class Machine>
+inline void op3XNN(Machine& c, TwoByte opcode) {
+    // skip if VX equals NN
+    if (c.registers[nibbleX(opcode)] == byteNN(opcode)) {
+        skipNext<P>(c);
+    }
+}
+
+template <QuirkProfile P, class Machine>
+inline void op4XNN(Machine& c, TwoByte opcode) {
+    // skip if VX does not equal NN
+    if (c.registers[nibbleX(opcode)] != byteNN(opcode)) {
+        skipNext<P>(c);
+    }
+}
+
+template <QuirkProfile P, class Machine>
+inline void op5XY0(Machine& c, TwoByte opcode) {
+    // skip if VX == VY
+    if (c.registers[nibbleX(opcode)] == c.registers[nibbleY(opcode)]) {
+        skipNext<P>(c);
+    }
+}
+
+template <QuirkProfile P, class Machine>
+inline void op5XY2(Machine& c, TwoByte opcode) {
+    // store VX to VY (either order) at I, I unchanged (XO-CHIP)
+    int x = nibbleX(opcode);
+    int y = nibbleY(opcode);
+    int step = x <= y ? 1 : -1;
+    for (int i = 0; i <= (y - x) * step; i++) {
+        c.ram[wrapAddress<P>(c.i_reg + i)] = c.registers[x + i * step];
+    }
+}
+
+template <QuirkProfile P, class Machine>
+inline void op5XY3(Machine& c, TwoByte opcode) {
+    // load VX to VY (either order) from I, I unchanged (XO-CHIP)
+    int x = nibbleX(opcode);
+    int y = nibbleY(opcode);
+    int step = x <= y ? 1 : -1;
+    for (int i = 0; i <= (y - x) * step; i++) {
+        c.registers[x + i * step] = c.ram[wrapAddress<P>(c.i_reg + i)];
+    }
+}
+
+template <QuirkProfile P, class Machine>
+inline void op6XNN(Machine& c, TwoByte opcode) {
+    // set register VX to NN
+    c.registers[nibbleX(opcode)] = byteNN(opcode);
+}
+
+template <QuirkProfile P, class Machine>
+inline void op7XNN(Machine& c, TwoByte opcode) {
+    // add value NN to register VX
+    c.registers[nibbleX(opcode)] += byteNN(opcode);
+}
+
+template <QuirkProfile P, class Machine>
+inline void op8XY0(Machine& c, TwoByte opcode) {
+    // Set VX to value of VY
+    c.registers[nibbleX(opcode)] = c.registers[nibbleY(opcode)];
+}
+
+template <QuirkProfile P, class Machine>
+inline void op8XY1(Machine& c, TwoByte opcode) {
+    // Binary OR
+    c.registers[nibbleX(opcode)] |= c.registers[nibbleY(opcode)];
+    if constexpr (quirksOf(P).logicResetsVF) {
+        c.registers[0xF] = 0;
+    }
+}
+
+template <QuirkProfile P, class Machine>
+inline void op8XY2(Machine& c, TwoByte opcode) {
+    // Binary AND
+    c.registers[nibbleX(opcode)] &= c.registers[nibbleY(opcode)];
+    if constexpr (quirksOf(P).logicResetsVF) {
+        c.registers[0xF] = 0;
+    }
+}
+
+template <QuirkProfile P, class Machine>
+inline void op8XY3(Machine& c, TwoByte opcode) {
+    // Logical XOR
+    c.registers[nibbleX(opcode)] ^= c.registers[nibbleY(opcode)];
+    if constexpr (quirksOf(P).logicResetsVF) {
+        c.registers[0xF] = 0;
+    }
+}
+
+template <QuirkProfile P, class Machine>
+inline void op8XY4(Machine& c, TwoByte opcode) {
+    // Add VX + VY
+    Byte& vx = c.registers[nibbleX(opcode)];
+    Byte vy = c.registers[nibbleY(opcode)];
+    // check for overflow
+    Byte isThereOverflow = vx + vy > 255;
+    vx += vy;
+    c.registers[0xF] = isThereOverflow;
+}
+
+template <QuirkProfile P, class Machine>
+inline void op8XY5(Machine& c, TwoByte opcode) {
+    // Subtract VX - VY
+    Byte& vx = c.registers[nibbleX(opcode)];
+    Byte vy = c.registers[nibbleY(opcode)];
+    Byte isThereUnderflow = vx < vy;
+    vx -= vy;
+    c.registers[0xF] = !isThereUnderflow;
+}
+
+template <QuirkProfile P, class Machine>
+inline void op8XY6(Machine& c, TwoByte opcode) {
+    // Shift right
+    Byte& vx = c.registers[nibbleX(opcode)];
+    if constexpr (quirksOf(P).shiftUsesVY) {
+        vx = c.registers[nibbleY(opcode)];
+    }
+    Byte shiftedBit = vx & 1;
+    vx = vx >> 1;
+    c.registers[0xF] = shiftedBit;
+}
+
+template <QuirkProfile P, class Machine>
+inline void op8XY7(Machine& c, TwoByte opcode) {
+    // Subtract VY - VX
+    Byte& vx = c.registers[nibbleX(opcode)];
+    Byte vy = c.registers[nibbleY(opcode)];
+    Byte isThereUnderflow = vx > vy;
+    vx = vy - vx;
+    c.registers[0xF] = !isThereUnderflow;
+}
+
+template <QuirkProfile P, class Machine>
+inline void op8XYE(Machine& c, TwoByte opcode) {
+    // Shift left
+    Byte& vx = c.registers[nibbleX(opcode)];
+    if constexpr (quirksOf(P).shiftUsesVY) {
+        vx = c.registers[nibbleY(opcode)];
+    }
+    Byte shiftedBit = vx >> 7;
+    vx = vx << 1;
+    c.registers[0xF] = shiftedBit;
+}
+
+template <QuirkProfile P, class Machine>
+inline void op9XY0(Machine& c, TwoByte opcode) {
+    // skip if VX != VY
+    if (c.registers[nibbleX(opcode)] != c.registers[nibbleY(opcode)]) {
+        skipNext<P>(c);
+    }
+}
+
+template <QuirkProfile P, class Machine>
+inline void opANNN(Machine& c, TwoByte opcode) {
+    // set index register I to NNN
+    c.i_reg = addrNNN(opcode);
+}
+
+template <QuirkProfile P, class Machine>
+inline void opBNNN(Machine& c, TwoByte opcode) {
+    // Jump with offset
+    if constexpr (quirksOf(P).jumpUsesVX) {
+        // XNN plus value in register VX
+        c.pc = c.registers[nibbleX(opcode)] + addrNNN(opcode);
+    } else {
+        c.pc = c.registers[0] + addrNNN(opcode);
+    }
+}
+
+template <QuirkProfile P, class Machine>
+inline void opCXNN(Machine& c, TwoByte opcode) {
+    // CXNN (Random)
+    c.registers[nibbleX(opcode)] = c.mt() & byteNN(opcode);
+}
+
+template <QuirkProfile P, class Machine>
+inline void opDXYN(Machine& c, TwoByte opcode) {
+    // display (DXYN)
+    // get x and y coordinates
+    int x = c.registers[nibbleX(opcode)] & (c.pixels.width - 1);
+    int y = c.registers[nibbleY(opcode)] & (c.pixels.height - 1);
+
+    // set flag register to 0
+    c.registers[0xF] = 0;
+
+    // DXY0 draws a 16x16 sprite of two bytes per row (SUPER-CHIP), and
+    // nothing on CHIP-8
+    int height = nibbleN(opcode);
+    bool wide = height == 0
+        && quirksOf(P).extensions != Extensions::None;
+    if (wide) {
+        height = 16;
+    }
+    int rows = std::min(height, c.pixels.height - y);
+
+    // each selected plane takes the next sprite in memory (XO-CHIP)
+    TwoByte address = c.i_reg;
+    for (int plane = 0; plane < Framebuffer::max_planes; plane++) {
+        if (!c.pixels.selected(plane)) {
+            continue;
+        }
+        // XOR the whole sprite row at once, clipped at the edges
+        bool collision = false;
+        if (wide) {
+            for (int i = 0; i < rows; i++) {
+                uint64_t sprite = (c.ram[wrapAddress<P>(address + 2 * i)] << 8)
+                    | c.ram[wrapAddress<P>(address + 2 * i + 1)];
+                collision |= c.pixels.drawRow(plane, x, y + i, sprite << 48);
+            }
+            address += 32;
+        } else {
+            for (int i = 0; i < rows; i++) {
+                uint64_t sprite = c.ram[wrapAddress<P>(address + i)];
+                collision |= c.pixels.drawRow(plane, x, y + i, sprite << 56);
+            }
+            address += height;
+        }
+        if (collision) {
+            c.registers[0xF] = 1;
+        }
+    }
+}
+
+template <QuirkProfile P, class Machine>
+inline void opEX9E(Machine& c, TwoByte opcode) {
+    // skip if key is pressed
+    if (c.keys[c.registers[nibbleX(opcode)] & 0xF]) {
+        skipNext<P>(c);
+    }
+}
+
+template <QuirkProfile P, class Machine>
+inline void opEXA1(Machine& c, TwoByte opcode) {
+    // skip if key is not pressed
+    if (!c.keys[c.registers[nibbleX(opcode)] & 0xF]) {
+        skipNext<P>(c);
+    }
+}
+
+template <QuirkProfile P, class Machine>
+inline void opF000(Machine& c, TwoByte) {
+    // load I with the 16-bit address that follows (XO-CHIP)
+    c.i_reg = (c.ram[wrapAddress<P>(c.pc)] << 8)
+        | c.ram[wrapAddress<P>(c.pc + 1)];
+    c.pc += 2;
+}
+
+template <QuirkProfile P, class Machine>
+inline void opFN01(Machine& c, TwoByte opcode) {
+    // select the planes drawn to (XO-CHIP)
+    c.pixels.planeMask = nibbleX(opcode);
+}
+
+template <QuirkProfile P, class Machine>
+inline void opF002(Machine& c, TwoByte) {
+    // load the 16-byte audio pattern from I (XO-CHIP)
+    for (int i = 0; i < (int)c.audioPattern.size(); i++) {
+        c.audioPattern[i] = c.ram[wrapAddress<P>(c.i_reg + i)];
+    }
+}
+
+template <QuirkProfile P, class Machine>
+inline void opFX07(Machine& c, TwoByte opcode) {
+    // Sets VX to delay timer value
+    c.registers[nibbleX(opcode)] = c.dTimer;
+}
+
+template <QuirkProfile P, class Machine>
+inline void opFX0A(Machine& c, TwoByte opcode) {
+    // Get key
+    c.pc -= 2;
+    if (c.lastKey == -1) {
+        for (int i = 0; i < (int)c.keys.size(); i++) {
+            if (c.keys[i]) {
+                c.registers[nibbleX(opcode)] = i;
+                c.lastKey = i;
+                break;
+            }
+        }
+    } else { // wait until released
+        if (!c.keys[c.lastKey & 0xF]) {
+            c.pc += 2;
+            c.lastKey = -1;
+        }
+    }
+}
+
+template <QuirkProfile P, class Machine>
+inline void opFX15(Machine& c, TwoByte opcode) {
+    // Sets delay timer to VX value
+    c.dTimer = c.registers[nibbleX(opcode)];
+}
+
+template <QuirkProfile P, class Machine>
+inline void opFX18(Machine& c, TwoByte opcode) {
+    // set sound timer to VX value
+    c.sTimer = c.registers[nibbleX(opcode)];
+}
+
+template <QuirkProfile P, class Machine>
+inline void opFX1E(Machine& c, TwoByte opcode) {
+    // add VX value to I register
+    int sum = c.i_reg + c.registers[nibbleX(opcode)];
+    c.i_reg = sum;
+    // Amiga (spacefight 2091!) behavior
+    if constexpr (quirksOf(P).indexOverflowSetsVF) {
+        c.registers[0xF] = sum > 0x0FFF;
+    }
+}
+
+template <QuirkProfile P, class Machine>
+inline void opFX29(Machine& c, TwoByte opcode) {
+    // font character
+    int offset = 5 * (c.registers[nibbleX(opcode)] & 0xF);
+    c.i_reg = Chip8::font_address + offset;
+}
+
+template <QuirkProfile P, class Machine>
+inline void opFX30(Machine& c, TwoByte opcode) {
+    // big font character (SUPER-CHIP)
+    int offset = 10 * (c.registers[nibbleX(opcode)] & 0xF);
+    c.i_reg = Chip8::big_font_address + offset;
+}
+
+template <QuirkProfile P, class Machine>
+inline void opFX33(Machine& c, TwoByte opcode) {
+    // binary-coded decimal conversion
+    Byte vx = c.registers[nibbleX(opcode)];
+    c.ram[wrapAddress<P>(c.i_reg)] = vx / 100;
+    c.ram[wrapAddress<P>(c.i_reg + 1)] = (vx / 10) % 10;
+    c.ram[wrapAddress<P>(c.i_reg + 2)] = vx % 10;
+}
+
+// I after FX55 / FX65
+template <QuirkProfile P, class Machine>
+inline void advanceIndex(Machine& c, Nibble x) {
+    constexpr IndexIncrement increment = quirksOf(P).indexIncrement;
+    if constexpr (increment == IndexIncrement::XPlusOne) {
+        c.i_reg = c.i_reg + x + 1;
+    } else if constexpr (increment == IndexIncrement::X) {
+        c.i_reg = c.i_reg + x;
+    }
+}
+
+template <QuirkProfile P, class Machine>
+inline void opFX3A(Machine& c, TwoByte opcode) {
+    // audio pattern playback pitch (XO-CHIP)
+    c.pitch = c.registers[nibbleX(opcode)];
+}
+
+template <QuirkProfile P, class Machine>
+inline void opFX55(Machine& c, TwoByte opcode) {
+    // store registers into memory
+    Nibble x = nibbleX(opcode);
+    for (int i = 0; i <= x; i++) {
+        c.ram[wrapAddress<P>(c.i_reg + i)] = c.registers[i];
+    }
+    advanceIndex<P>(c, x);
+}
+
+template <QuirkProfile P, class Machine>
+inline void opFX65(Machine& c, TwoByte opcode) {
+    // load memory into registers
+    Nibble x = nibbleX(opcode);
+    for (int i = 0; i <= x; i++) {
+        c.registers[i] = c.ram[wrapAddress<P>(c.i_reg + i)];
+    }
+    advanceIndex<P>(c, x);
+}
+
+template <QuirkProfile P, class Machine>
+inline void opFX75(Machine& c, TwoByte opcode) {
+    // save V0 to VX in the RPL user flags (SUPER-CHIP)
+    for (int i = 0; i <= nibbleX(opcode); i++) {
+        c.flags[i] = c.registers[i];
+    }
+}
+
+template <QuirkProfile P, class Machine>
+inline void opFX85(Machine& c, TwoByte opcode) {
+    // load V0 to VX from the RPL user flags
+    for (int i = 0; i <= nibbleX(opcode); i++) {
+        c.registers[i] = c.flags[i];
+    }
+}
+
+#endif
@@ -0,0 +1,124 @@
+#include "debug_console.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+int DebugConsole::open(int port, LineHandler handler) {
+    this->port = port;
+    this->handler = handler;
+    if (port == 0) {
+        // a blocking read can't be interrupted, so the thread is left to
+        // end with stdin and only forwards lines while the console is open
+        stdinReader = std::make_shared<Stdin>();
+        stdinReader->handler = handler;
+        std::thread([](std::shared_ptr<Stdin> input) {
+            std::string line;
+            while (std::getline(std::cin, line)) {
+                std::lock_guard<std::mutex> lock(input->lock);
+                if (input->handler) input->handler(line);
+            }
+        }, stdinReader).detach();
+        return 0;
+    }
+#ifdef _WIN32
+    std::cerr << "Debug port is not supported on this platform.\n";
+    return 1;
+#else
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    // local connections only
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (listener < 0
+            || bind(listener, (sockaddr*)&address, sizeof(address)) != 0
+            || listen(listener, 1) != 0) {
+        std::cerr << "Debug port could not be opened.\n";
+        close();
+        return 1;
+    }
+    reader = std::thread(&DebugConsole::serve, this);
+    return 0;
+#endif
+}
+
+void DebugConsole::close() {
+    if (stdinReader) {
+        std::lock_guard<std::mutex> lock(stdinReader->lock);
+        stdinReader->handler = nullptr;
+    }
+#ifndef _WIN32
+    if (listener >= 0) {
+        // wakes the reader from accept() / recv()
+        shutdown(listener, SHUT_RDWR);
+        {
+            std::lock_guard<std::mutex> lock(clientLock);
+            if (client >= 0) shutdown(client, SHUT_RDWR);
+        }
+        if (reader.joinable()) reader.join();
+        ::close(listener);
+        listener = -1;
+    }
+#endif
+}
+
+void DebugConsole::write(const std::string& text) {
+    if (port == 0) {
+        std::fwrite(text.data(), 1, text.size(), stdout);
+        std::fflush(stdout);
+        return;
+    }
+#ifndef _WIN32
+    std::lock_guard<std::mutex> lock(clientLock);
+    if (client >= 0) {
+        send(client, text.data(), text.size(), MSG_NOSIGNAL);
+    }
+#endif
+}
+
+void DebugConsole::serve() {
+#ifndef _WIN32
+    while (true) {
+        int connection = accept(listener, NULL, NULL);
+        if (connection < 0) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(clientLock);
+            client = connection;
+        }
+        std::string pending;
+        char buffer[256];
+        ssize_t received;
+        while ((received = recv(connection, buffer, sizeof(buffer), 0)) > 0) {
+            pending.append(buffer, received);
+            size_t end;
+            while ((end = pending.find('\n')) != std::string::npos) {
+                std::string line = pending.substr(0, end);
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                handler(line);
+                pending.erase(0, end + 1);
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(clientLock);
+            client = -1;
+        }
+        ::close(connection);
+    }
+#endif
+}
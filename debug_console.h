@@ -0,0 +1,46 @@
+#ifndef DEBUG_CONSOLE_H
+#define DEBUG_CONSOLE_H
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Line transport for the debugger: commands come from stdin or from one
+// client at a time on a localhost TCP port (e.g. nc 127.0.0.1 PORT), and
+// output goes back the same way. Lines are read on a thread of its own.
+class DebugConsole {
+public:
+    using LineHandler = std::function<void(const std::string&)>;
+
+    DebugConsole() : port(0), listener(-1), client(-1) {}
+    ~DebugConsole() { close(); }
+
+    // port 0 for stdin, 1 on error
+    int open(int port, LineHandler handler);
+    void close();
+
+    // send text to the console, from any thread
+    void write(const std::string& text);
+
+private:
+    // outlives the console for the stdin reader, which can't be joined
+    struct Stdin {
+        std::mutex lock;
+        LineHandler handler;
+    };
+
+    void serve();
+
+    int port;
+    LineHandler handler;
+    std::shared_ptr<Stdin> stdinReader;
+    std::thread reader;
+    // sockets, -1 when closed
+    int listener;
+    int client;
+    std::mutex clientLock;
+};
+
+#endif
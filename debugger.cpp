@@ -0,0 +1,436 @@
+#include "debugger.h"
+
+#include <cctype>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+#include "chip8.h"
+
+// RAM byte at address, wrapped to the profile's memory like the core does
+static Byte peek(const Chip8& chip8, int address) {
+    return chip8.ram[address & (chip8.memorySize() - 1)];
+}
+
+Debugger::Debugger(Output output)
+    : output(output), stopped(false), pauseRequested(false),
+      resuming(false), stepsLeft(-1), steppingOver(false), overReturn(0),
+      overDepth(0) {
+}
+
+const char* Debugger::help() {
+    return
+        "break ADDR / delete ADDR     breakpoint on pc\n"
+        "watch ADDR [LEN] / unwatch ADDR [LEN]\n"
+        "                             stop before FX33 / FX55 / 5XY2 "
+        "write there\n"
+        "cond REG OP VALUE            stop when it becomes true, e.g. "
+        "cond V3 == 0x10\n"
+        "                             (REG V0-VF I PC SP DT ST, "
+        "OP == != < <= > >=)\n"
+        "uncond N                     remove condition N\n"
+        "list                         breakpoints, watches, conditions\n"
+        "pause / continue             stop or resume\n"
+        "step [N] / next              N instructions / step over 2NNN\n"
+        "regs / stack                 registers / call stack\n"
+        "dis [ADDR] [N]               disassemble (default pc, 8)\n"
+        "mem ADDR [LEN]               hex dump (default 64 bytes)\n"
+        "help\n";
+}
+
+void Debugger::post(const std::string& line) {
+    std::lock_guard<std::mutex> lock(queueLock);
+    queue.push_back(line);
+}
+
+void Debugger::poll(Chip8& chip8) {
+    std::vector<std::string> lines;
+    {
+        std::lock_guard<std::mutex> lock(queueLock);
+        lines.swap(queue);
+    }
+    for (const std::string& line : lines) {
+        execute(chip8, line);
+    }
+    // the instrumented loop only runs while it has something to do
+    chip8.debugger = armed() ? this : nullptr;
+}
+
+bool Debugger::armed() const {
+    return stopped || pauseRequested || stepsLeft >= 0 || steppingOver
+        || breakpoints.any() || watched.any() || !conditions.empty();
+}
+
+void Debugger::print(const char* format, ...) {
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    std::vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    output(line);
+}
+
+bool Debugger::stop(Chip8& chip8, const char* reason) {
+    stopped = true;
+    pauseRequested = false;
+    stepsLeft = -1;
+    steppingOver = false;
+    print("stopped (%s)\n", reason);
+    printDisassembly(chip8, chip8.pc, 1);
+    return true;
+}
+
+bool Debugger::check(Chip8& chip8) {
+    if (stopped) {
+        return true;
+    }
+    if (resuming) {
+        // don't stop again on the breakpoint or watch just resumed from
+        resuming = false;
+    } else if (pauseRequested) {
+        return stop(chip8, "pause");
+    } else if (stepsLeft == 0) {
+        return stop(chip8, "step");
+    } else if (steppingOver && chip8.pc == overReturn
+            && chip8.sp == overDepth) {
+        return stop(chip8, "step");
+    } else if (breakpoints[chip8.pc & (chip8.memorySize() - 1)]) {
+        return stop(chip8, "breakpoint");
+    } else if (watched.any() && writesWatched(chip8)) {
+        return stop(chip8, "watchpoint");
+    } else if (!conditions.empty() && conditionHit(chip8)) {
+        return stop(chip8, "condition");
+    }
+    if (stepsLeft > 0) {
+        stepsLeft--;
+    }
+    return false;
+}
+
+bool Debugger::writesWatched(const Chip8& chip8) const {
+    uint16_t opcode = peek(chip8, chip8.pc) << 8
+        | peek(chip8, chip8.pc + 1);
+    int x = (opcode >> 8) & 0xF;
+    int y = (opcode >> 4) & 0xF;
+    int length;
+    switch (decodeOpcode(opcode, quirksOf(chip8.profile).extensions)) {
+    case OP_FX33: length = 3; break;
+    case OP_FX55: length = x + 1; break;
+    case OP_5XY2: length = std::abs(x - y) + 1; break;
+    default: return false;
+    }
+    for (int i = 0; i < length; i++) {
+        int address = (chip8.i_reg + i) & (chip8.memorySize() - 1);
+        if (watched[address]) return true;
+    }
+    return false;
+}
+
+int Debugger::read(const Chip8& chip8, Target target, int index) {
+    switch (target) {
+    case Target::V: return chip8.registers[index];
+    case Target::I: return chip8.i_reg;
+    case Target::PC: return chip8.pc;
+    case Target::SP: return chip8.sp;
+    case Target::DT: return chip8.dTimer;
+    default: return chip8.sTimer;
+    }
+}
+
+bool Debugger::conditionHit(const Chip8& chip8) {
+    bool hit = false;
+    for (Condition& condition : conditions) {
+        int value = read(chip8, condition.target, condition.index);
+        bool now;
+        switch (condition.compare) {
+        case Compare::Equal: now = value == condition.value; break;
+        case Compare::NotEqual: now = value != condition.value; break;
+        case Compare::Less: now = value < condition.value; break;
+        case Compare::LessEqual: now = value <= condition.value; break;
+        case Compare::Greater: now = value > condition.value; break;
+        default: now = value >= condition.value; break;
+        }
+        hit = hit || (now && !condition.last);
+        condition.last = now;
+    }
+    return hit;
+}
+
+bool Debugger::parseCondition(const std::string& text,
+        Condition& condition) {
+    std::istringstream fields {text};
+    std::string reg, compare, value;
+    if (!(fields >> reg >> compare >> value)) return false;
+
+    for (char& c : reg) c = std::toupper((unsigned char)c);
+    condition.index = 0;
+    if (reg.size() == 2 && reg[0] == 'V' && std::isxdigit(reg[1])) {
+        condition.target = Target::V;
+        condition.index = std::strtol(reg.c_str() + 1, NULL, 16);
+    } else if (reg == "I") {
+        condition.target = Target::I;
+    } else if (reg == "PC") {
+        condition.target = Target::PC;
+    } else if (reg == "SP") {
+        condition.target = Target::SP;
+    } else if (reg == "DT") {
+        condition.target = Target::DT;
+    } else if (reg == "ST") {
+        condition.target = Target::ST;
+    } else {
+        return false;
+    }
+
+    const char* compares[] = { "==", "!=", "<", "<=", ">", ">=" };
+    int found = -1;
+    for (int i = 0; i < 6; i++) {
+        if (compare == compares[i]) found = i;
+    }
+    if (found < 0) return false;
+    condition.compare = (Compare)found;
+
+    char* end;
+    condition.value = std::strtol(value.c_str(), &end, 0);
+    condition.text = reg + " " + compare + " " + value;
+    condition.last = false;
+    return *end == '\0';
+}
+
+void Debugger::execute(Chip8& chip8, const std::string& line) {
+    std::istringstream fields {line};
+    std::string command;
+    if (!(fields >> command)) return;
+    // addresses are hex like the ones printed, counts decimal
+    auto number = [&fields](long& value, int base) {
+        std::string token;
+        if (!(fields >> token)) return false;
+        char* end;
+        value = std::strtol(token.c_str(), &end, base);
+        return *end == '\0';
+    };
+    long address = 0;
+    long count = 0;
+
+    if (command == "break" || command == "b") {
+        if (!number(address, 16)) {
+            print("usage: break ADDR\n");
+            return;
+        }
+        breakpoints.set(address & 0xFFFF);
+    } else if (command == "delete" || command == "d") {
+        if (!number(address, 16)) {
+            print("usage: delete ADDR\n");
+            return;
+        }
+        breakpoints.reset(address & 0xFFFF);
+    } else if (command == "watch" || command == "unwatch") {
+        if (!number(address, 16)) {
+            print("usage: %s ADDR [LEN]\n", command.c_str());
+            return;
+        }
+        if (!number(count, 10)) count = 1;
+        for (long i = 0; i < count && i < 0x10000; i++) {
+            watched.set((address + i) & 0xFFFF, command == "watch");
+        }
+    } else if (command == "cond") {
+        std::string rest;
+        std::getline(fields, rest);
+        Condition condition;
+        if (!parseCondition(rest, condition)) {
+            print("usage: cond REG OP VALUE\n");
+            return;
+        }
+        // a condition already true when set fires on its next change
+        condition.last = true;
+        conditions.push_back(condition);
+        print("condition %d: %s\n", (int)conditions.size() - 1,
+            condition.text.c_str());
+    } else if (command == "uncond") {
+        fields >> std::dec >> count;
+        if (!fields || count < 0 || count >= (long)conditions.size()) {
+            print("no such condition\n");
+            return;
+        }
+        conditions.erase(conditions.begin() + count);
+    } else if (command == "list") {
+        for (int a = 0; a < 0x10000; a++) {
+            if (breakpoints[a]) print("break %04X\n", a);
+        }
+        for (int a = 0; a < 0x10000; a++) {
+            if (!watched[a]) continue;
+            int end = a;
+            while (end + 1 < 0x10000 && watched[end + 1]) end++;
+            print("watch %04X-%04X\n", a, end);
+            a = end;
+        }
+        for (size_t i = 0; i < conditions.size(); i++) {
+            print("cond %d: %s\n", (int)i, conditions[i].text.c_str());
+        }
+    } else if (command == "pause") {
+        if (!stopped) pauseRequested = true;
+    } else if (command == "continue" || command == "c") {
+        resuming = stopped;
+        stopped = false;
+        pauseRequested = false;
+    } else if (command == "step" || command == "s") {
+        if (!number(count, 10) || count < 1) count = 1;
+        resuming = true;
+        stopped = false;
+        pauseRequested = false;
+        stepsLeft = count;
+    } else if (command == "next" || command == "n") {
+        uint16_t opcode = peek(chip8, chip8.pc) << 8
+            | peek(chip8, chip8.pc + 1);
+        resuming = true;
+        stopped = false;
+        pauseRequested = false;
+        if (decodeOpcode(opcode, quirksOf(chip8.profile).extensions)
+                == OP_2NNN) {
+            // run the whole subroutine, stop once it has returned
+            steppingOver = true;
+            overReturn = chip8.pc + 2;
+            overDepth = chip8.sp;
+        } else {
+            stepsLeft = 1;
+        }
+    } else if (command == "regs" || command == "r") {
+        printRegisters(chip8);
+    } else if (command == "stack" || command == "bt") {
+        printStack(chip8);
+    } else if (command == "dis") {
+        if (!number(address, 16)) address = chip8.pc;
+        if (!number(count, 10)) count = 8;
+        printDisassembly(chip8, address, count);
+    } else if (command == "mem" || command == "x") {
+        if (!number(address, 16)) {
+            print("usage: mem ADDR [LEN]\n");
+            return;
+        }
+        if (!number(count, 10)) count = 64;
+        printMemory(chip8, address, count);
+    } else if (command == "help" || command == "h") {
+        output(help());
+    } else {
+        print("unknown command, try help\n");
+    }
+}
+
+void Debugger::printRegisters(const Chip8& chip8) {
+    for (int i = 0; i < 16; i++) {
+        print("V%X=%02X%s", i, chip8.registers[i], i % 8 == 7 ? "\n" : " ");
+    }
+    print("PC=%04X I=%04X SP=%X DT=%02X ST=%02X keys=%04X%s\n",
+        chip8.pc, chip8.i_reg, chip8.sp, chip8.dTimer, chip8.sTimer,
+        chip8.keyMask(), stopped ? " (stopped)" : "");
+}
+
+void Debugger::printDisassembly(const Chip8& chip8, int address,
+        int count) {
+    for (int n = 0; n < count; n++) {
+        address &= chip8.memorySize() - 1;
+        uint16_t opcode = peek(chip8, address) << 8
+            | peek(chip8, address + 1);
+        uint16_t next = peek(chip8, address + 2) << 8
+            | peek(chip8, address + 3);
+        Extensions extensions = quirksOf(chip8.profile).extensions;
+        print("%s%04X  %04X  %s\n", address == chip8.pc ? ">" : " ",
+            address, opcode, disassemble(opcode, extensions, next).c_str());
+        // F000 NNNN is four bytes long
+        bool longLoad = extensions == Extensions::XoChip && opcode == 0xF000;
+        address += longLoad ? 4 : 2;
+    }
+}
+
+void Debugger::printStack(const Chip8& chip8) {
+    print("#0  %04X\n", chip8.pc);
+    for (int level = chip8.sp - 1; level >= 0; level--) {
+        // the stack holds return addresses, the call is just before
+        uint16_t call = (chip8.stack[level] - 2) & (chip8.memorySize() - 1);
+        print("#%-2d %04X  %s\n", chip8.sp - level, call,
+            disassemble(peek(chip8, call) << 8
+                | peek(chip8, call + 1),
+                quirksOf(chip8.profile).extensions).c_str());
+    }
+}
+
+void Debugger::printMemory(const Chip8& chip8, int address, int length) {
+    for (int row = 0; row < length; row += 16) {
+        std::string line;
+        char byte[4];
+        for (int i = row; i < row + 16 && i < length; i++) {
+            std::snprintf(byte, sizeof(byte), " %02X",
+                peek(chip8, address + i));
+            line += byte;
+        }
+        print("%04X %s\n", (address + row) & 0xFFFF, line.c_str());
+    }
+}
+
+std::string disassemble(uint16_t opcode, Extensions extensions,
+        uint16_t next) {
+    int x = (opcode >> 8) & 0xF;
+    int y = (opcode >> 4) & 0xF;
+    int n = opcode & 0xF;
+    int nn = opcode & 0xFF;
+    int nnn = opcode & 0xFFF;
+    char text[32];
+    switch (decodeOpcode(opcode, extensions)) {
+#define CHIP8_DIS(op, ...) \
+    case OP_##op: std::snprintf(text, sizeof(text), __VA_ARGS__); break;
+    CHIP8_DIS(00E0, "CLS")
+    CHIP8_DIS(00EE, "RET")
+    CHIP8_DIS(0NNN, "SYS %03X", nnn)
+    CHIP8_DIS(00CN, "SCD %d", n)
+    CHIP8_DIS(00DN, "SCU %d", n)
+    CHIP8_DIS(00FB, "SCR")
+    CHIP8_DIS(00FC, "SCL")
+    CHIP8_DIS(00FD, "EXIT")
+    CHIP8_DIS(00FE, "LOW")
+    CHIP8_DIS(00FF, "HIGH")
+    CHIP8_DIS(1NNN, "JP %03X", nnn)
+    CHIP8_DIS(2NNN, "CALL %03X", nnn)
+    CHIP8_DIS(3XNN, "SE V%X, %02X", x, nn)
+    CHIP8_DIS(4XNN, "SNE V%X, %02X", x, nn)
+    CHIP8_DIS(5XY0, "SE V%X, V%X", x, y)
+    CHIP8_DIS(5XY2, "SAVE V%X-V%X", x, y)
+    CHIP8_DIS(5XY3, "LOAD V%X-V%X", x, y)
+    CHIP8_DIS(6XNN, "LD V%X, %02X", x, nn)
+    CHIP8_DIS(7XNN, "ADD V%X, %02X", x, nn)
+    CHIP8_DIS(8XY0, "LD V%X, V%X", x, y)
+    CHIP8_DIS(8XY1, "OR V%X, V%X", x, y)
+    CHIP8_DIS(8XY2, "AND V%X, V%X", x, y)
+    CHIP8_DIS(8XY3, "XOR V%X, V%X", x, y)
+    CHIP8_DIS(8XY4, "ADD V%X, V%X", x, y)
+    CHIP8_DIS(8XY5, "SUB V%X, V%X", x, y)
+    CHIP8_DIS(8XY6, "SHR V%X, V%X", x, y)
+    CHIP8_DIS(8XY7, "SUBN V%X, V%X", x, y)
+    CHIP8_DIS(8XYE, "SHL V%X, V%X", x, y)
+    CHIP8_DIS(9XY0, "SNE V%X, V%X", x, y)
+    CHIP8_DIS(ANNN, "LD I, %03X", nnn)
+    CHIP8_DIS(BNNN, "JP V0, %03X", nnn)
+    CHIP8_DIS(CXNN, "RND V%X, %02X", x, nn)
+    CHIP8_DIS(DXYN, "DRW V%X, V%X, %d", x, y, n)
+    CHIP8_DIS(EX9E, "SKP V%X", x)
+    CHIP8_DIS(EXA1, "SKNP V%X", x)
+    CHIP8_DIS(F000, "LD I, %04X", next)
+    CHIP8_DIS(FN01, "PLANE %d", x)
+    CHIP8_DIS(F002, "AUDIO")
+    CHIP8_DIS(FX07, "LD V%X, DT", x)
+    CHIP8_DIS(FX0A, "LD V%X, K", x)
+    CHIP8_DIS(FX15, "LD DT, V%X", x)
+    CHIP8_DIS(FX18, "LD ST, V%X", x)
+    CHIP8_DIS(FX1E, "ADD I, V%X", x)
+    CHIP8_DIS(FX29, "LD F, V%X", x)
+    CHIP8_DIS(FX30, "LD HF, V%X", x)
+    CHIP8_DIS(FX33, "LD B, V%X", x)
+    CHIP8_DIS(FX3A, "PITCH V%X", x)
+    CHIP8_DIS(FX55, "LD [I], V%X", x)
+    CHIP8_DIS(FX65, "LD V%X, [I]", x)
+    CHIP8_DIS(FX75, "LD R, V%X", x)
+    CHIP8_DIS(FX85, "LD V%X, R", x)
+#undef CHIP8_DIS
+    default: std::snprintf(text, sizeof(text), "DW %04X", opcode); break;
+    }
+    return text;
+}
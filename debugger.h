@@ -0,0 +1,94 @@
+#ifndef DEBUGGER_H
+#define DEBUGGER_H
+
+#include <bitset>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "quirks.h"
+
+class Chip8;
+
+// Breakpoints, write watchpoints, register conditions and stepping,
+// driven by text commands (see help()). While anything is armed the core
+// runs an instrumented loop that asks check() before every instruction;
+// otherwise poll() detaches it and the normal engines run untouched.
+//
+// Commands may be posted from any thread; they are executed, and the core
+// inspected, by poll() on the thread that runs the core.
+class Debugger {
+public:
+    using Output = std::function<void(const std::string&)>;
+
+    explicit Debugger(Output output);
+
+    // queue a command line
+    void post(const std::string& line);
+    // run queued commands, then attach to or detach from the core
+    void poll(Chip8& chip8);
+
+    // from the instrumented loop: true to stop before the instruction at pc
+    bool check(Chip8& chip8);
+    // stopped, the core executes nothing and its timers hold
+    bool paused() const { return stopped; }
+
+    static const char* help();
+
+private:
+    // register a condition compares
+    enum class Target { V, I, PC, SP, DT, ST };
+    enum class Compare { Equal, NotEqual, Less, LessEqual, Greater,
+        GreaterEqual };
+    struct Condition {
+        Target target;
+        int index;
+        Compare compare;
+        int value;
+        std::string text;
+        // true when last evaluated, conditions fire on becoming true
+        bool last;
+    };
+
+    void execute(Chip8& chip8, const std::string& line);
+    bool armed() const;
+    bool stop(Chip8& chip8, const char* reason);
+    bool writesWatched(const Chip8& chip8) const;
+    bool conditionHit(const Chip8& chip8);
+    static bool parseCondition(const std::string& text, Condition& condition);
+    static int read(const Chip8& chip8, Target target, int index);
+
+    void printRegisters(const Chip8& chip8);
+    void printDisassembly(const Chip8& chip8, int address, int count);
+    void printStack(const Chip8& chip8);
+    void printMemory(const Chip8& chip8, int address, int length);
+    void print(const char* format, ...);
+
+    Output output;
+    std::mutex queueLock;
+    std::vector<std::string> queue;
+
+    std::bitset<65536> breakpoints;
+    std::bitset<65536> watched;
+    std::vector<Condition> conditions;
+    bool stopped;
+    // stop before the next instruction
+    bool pauseRequested;
+    // first instruction after resuming does not stop again where it is
+    bool resuming;
+    // instructions left to step, -1 when not stepping
+    int stepsLeft;
+    // stepping over a 2NNN call: stop when it returns to here
+    bool steppingOver;
+    uint16_t overReturn;
+    int overDepth;
+};
+
+// one instruction as assembly, e.g. "LD V3, 0x1F", decoded with the given
+// extensions; F000 takes the next word as its address
+std::string disassemble(uint16_t opcode, Extensions extensions,
+    uint16_t next = 0);
+
+#endif
@@ -0,0 +1,246 @@
+#include "chip8.h"
+#include "chip8_ops.h"
+
+#include <cstring>
+
+template <QuirkProfile P>
+const OpClass* opcodeClasses() {
+    static const struct Classes {
+        OpClass classes[0x10000];
+
+        Classes() {
+            for (int opcode = 0; opcode < 0x10000; opcode++) {
+                classes[opcode] = decodeOpcode(opcode,
+                    quirksOf(P).extensions);
+            }
+        }
+    } table;
+    return table.classes;
+}
+
+// shared with MultiHost
+#define CHIP8_PROFILE_CLASSES(name, flag) \
+    template const OpClass* opcodeClasses<QuirkProfile::name>();
+CHIP8_QUIRK_PROFILES(CHIP8_PROFILE_CLASSES)
+#undef CHIP8_PROFILE_CLASSES
+
+namespace {
+
+// handler for each OpClass under profile P
+template <QuirkProfile P>
+struct HandlerTable {
+    static constexpr OpHandler handlers[OP_COUNT] = {
+#define CHIP8_HANDLER(name) op##name<P>,
+        CHIP8_OPCODES(CHIP8_HANDLER)
+#undef CHIP8_HANDLER
+    };
+};
+
+// opcode -> handler for the Table engine, built on first use so only the
+// profiles actually run pay for one
+template <QuirkProfile P>
+const OpHandler* opcodeHandlers() {
+    static const struct Handlers {
+        OpHandler handlers[0x10000];
+
+        Handlers() {
+            const OpClass* classes = opcodeClasses<P>();
+            for (int opcode = 0; opcode < 0x10000; opcode++) {
+                handlers[opcode] = HandlerTable<P>::handlers[classes[opcode]];
+            }
+        }
+    } table;
+    return table.handlers;
+}
+
+}
+
+const char* quirkProfileName(QuirkProfile profile) {
+    switch (profile) {
+#define CHIP8_PROFILE_NAME(name, flag) case QuirkProfile::name: return flag;
+        CHIP8_QUIRK_PROFILES(CHIP8_PROFILE_NAME)
+#undef CHIP8_PROFILE_NAME
+    }
+    return "?";
+}
+
+bool parseQuirkProfile(const char* name, QuirkProfile& profile) {
+#define CHIP8_PROFILE_PARSE(value, flag) \
+    if (std::strcmp(name, flag) == 0) { \
+        profile = QuirkProfile::value; \
+        return true; \
+    }
+    CHIP8_QUIRK_PROFILES(CHIP8_PROFILE_PARSE)
+#undef CHIP8_PROFILE_PARSE
+    return false;
+}
+
+const char* opClassName(OpClass opClass) {
+    static const char* const names[OP_COUNT] = {
+#define CHIP8_NAME(name) #name,
+        CHIP8_OPCODES(CHIP8_NAME)
+#undef CHIP8_NAME
+    };
+    return opClass < OP_COUNT ? names[opClass] : "?";
+}
+
+template <QuirkProfile P>
+void Chip8::stepAs() {
+    TwoByte writeAddress = i_reg;
+    TwoByte opcode = fetch<P>();
+    OpClass opClass = decodeOpcode(opcode, quirksOf(P).extensions);
+    switch (opClass) {
+#define CHIP8_CASE(name) case OP_##name: op##name<P>(*this, opcode); break;
+        CHIP8_OPCODES(CHIP8_CASE)
+#undef CHIP8_CASE
+    default: break;
+    }
+    // keep translated blocks coherent with RAM
+    if (!blocks.empty()) {
+        checkCodeWrite(opClass, opcode, writeAddress);
+    }
+}
+
+// single steps are the slow path, so the profile is picked per call
+void Chip8::step() {
+    switch (profile) {
+#define CHIP8_PROFILE_CASE(name, flag) \
+    case QuirkProfile::name: stepAs<QuirkProfile::name>(); break;
+        CHIP8_QUIRK_PROFILES(CHIP8_PROFILE_CASE)
+#undef CHIP8_PROFILE_CASE
+    }
+}
+
+void Chip8::run(int count) {
+    // checking loop only while a debugger has something armed
+    if (debugger != nullptr) {
+        if (!blocks.empty()) {
+            blocks.clear();
+        }
+        switch (profile) {
+#define CHIP8_PROFILE_CASE(name, flag) \
+        case QuirkProfile::name: runDebugged<QuirkProfile::name>(count); break;
+            CHIP8_QUIRK_PROFILES(CHIP8_PROFILE_CASE)
+#undef CHIP8_PROFILE_CASE
+        }
+        return;
+    }
+#if CHIP8_PROFILER
+    // instrumented loop only while a profiler is attached
+    if (profiler != nullptr) {
+        if (!blocks.empty()) {
+            blocks.clear();
+        }
+        switch (profile) {
+#define CHIP8_PROFILE_CASE(name, flag) \
+        case QuirkProfile::name: runProfiled<QuirkProfile::name>(count); break;
+            CHIP8_QUIRK_PROFILES(CHIP8_PROFILE_CASE)
+#undef CHIP8_PROFILE_CASE
+        }
+        return;
+    }
+#endif
+    if (engine == Engine::Blocks) {
+        // blocks are decoded for the profile they were translated for
+        if (blocksProfile != profile) {
+            blocks.clear();
+            blocksProfile = profile;
+        }
+        runBlocks(count);
+        return;
+    }
+    // other engines don't track code writes, so the cache goes stale
+    if (!blocks.empty()) {
+        blocks.clear();
+    }
+    // pick the specialized loop once per call, not per instruction
+    switch (profile) {
+#define CHIP8_PROFILE_CASE(name, flag) \
+    case QuirkProfile::name: \
+        if (engine == Engine::Table) { \
+            runTable<QuirkProfile::name>(count); \
+        } else { \
+            runThreaded<QuirkProfile::name>(count); \
+        } \
+        break;
+        CHIP8_QUIRK_PROFILES(CHIP8_PROFILE_CASE)
+#undef CHIP8_PROFILE_CASE
+    }
+}
+
+template <QuirkProfile P>
+void Chip8::runTable(int count) {
+    const OpHandler* handlers = opcodeHandlers<P>();
+    for (int n = 0; n < count; n++) {
+        TwoByte opcode = fetch<P>();
+        handlers[opcode](*this, opcode);
+    }
+}
+
+template <QuirkProfile P>
+void Chip8::runThreaded(int count) {
+    const OpClass* classes = opcodeClasses<P>();
+    TwoByte opcode;
+#if CHIP8_COMPUTED_GOTO
+    static void* const labels[OP_COUNT] = {
+#define CHIP8_LABEL(name) &&L_##name,
+        CHIP8_OPCODES(CHIP8_LABEL)
+#undef CHIP8_LABEL
+    };
+    // each handler jumps straight to the next one
+#define CHIP8_DISPATCH() \
+    if (count-- <= 0) return; \
+    opcode = fetch<P>(); \
+    goto *labels[classes[opcode]]
+
+    CHIP8_DISPATCH();
+#define CHIP8_THREADED(name) \
+    L_##name: op##name<P>(*this, opcode); CHIP8_DISPATCH();
+    CHIP8_OPCODES(CHIP8_THREADED)
+#undef CHIP8_THREADED
+#undef CHIP8_DISPATCH
+#else
+    while (count-- > 0) {
+        opcode = fetch<P>();
+        switch (classes[opcode]) {
+#define CHIP8_CASE(name) \
+            case OP_##name: op##name<P>(*this, opcode); break;
+            CHIP8_OPCODES(CHIP8_CASE)
+#undef CHIP8_CASE
+        default: break;
+        }
+    }
+#endif
+}
+
+#if CHIP8_PROFILER
+// handler table dispatch plus a count per opcode class and address
+template <QuirkProfile P>
+void Chip8::runProfiled(int count) {
+    const OpClass* classes = opcodeClasses<P>();
+    for (int n = 0; n < count; n++) {
+        TwoByte address = pc;
+        TwoByte opcode = fetch<P>();
+        OpClass opClass = classes[opcode];
+        profiler->instruction(address, opClass);
+        HandlerTable<P>::handlers[opClass](*this, opcode);
+        // key waits and jumps to self spin without doing any work
+        if (pc == address) {
+            profiler->idle();
+        }
+    }
+}
+#endif
+
+// handler table dispatch, asking the debugger before every instruction
+template <QuirkProfile P>
+void Chip8::runDebugged(int count) {
+    const OpClass* classes = opcodeClasses<P>();
+    for (int n = 0; n < count; n++) {
+        if (debugger->check(*this)) {
+            return;
+        }
+        TwoByte opcode = fetch<P>();
+        HandlerTable<P>::handlers[classes[opcode]](*this, opcode);
+    }
+}
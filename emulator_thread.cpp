@@ -0,0 +1,186 @@
+#include "emulator_thread.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+EmulatorThread::EmulatorThread(Chip8& chip8, const Settings& settings)
+    : chip8(chip8), settings(settings), scheduler(frame_rate),
+      rewind(settings.rewindSeconds), haveSnapshot(false), saveReady(false),
+      achievedRate(0),
+#if CHIP8_PROFILER
+      showOverlay(false), presentNs(0),
+#endif
+      keys(0), rewinding(false), fastForward(false), requests(0),
+      running(false) {
+    if (settings.snapshot != NULL) {
+        snapshot = *settings.snapshot;
+        haveSnapshot = true;
+    }
+}
+
+void EmulatorThread::start() {
+    running = true;
+    thread = std::thread(&EmulatorThread::run, this);
+}
+
+void EmulatorThread::stop() {
+    running = false;
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+void EmulatorThread::handleRequests() {
+    int pending = requests.exchange(0);
+    if (pending & save_request) {
+        if (saveReady.load(std::memory_order_acquire)) {
+            // the last one isn't written yet, try again next frame
+            requests.fetch_or(save_request);
+        } else {
+            // quick save, kept in memory; the front end writes it to
+            // disk so a slow write never delays a frame
+            chip8.save(snapshot);
+            haveSnapshot = true;
+            std::memcpy((void*)&saved, &snapshot, snapshotSize(snapshot));
+            saveReady.store(true, std::memory_order_release);
+        }
+    }
+    if (pending & load_request) {
+        // quick load, from memory or the state file
+        if (haveSnapshot || readSnapshot(snapshot,
+                settings.statePath.c_str()) == 0) {
+            if (snapshotFits(snapshot, chip8)) {
+                chip8.restore(snapshot);
+                haveSnapshot = true;
+                rewind.clear();
+            } else {
+                std::cerr << "Save state was made with a different quirk "
+                    "profile.\n";
+            }
+        }
+    }
+}
+
+void EmulatorThread::writeSave() {
+    if (saveReady.load(std::memory_order_acquire)) {
+        writeSnapshot(saved, settings.statePath.c_str());
+        saveReady.store(false, std::memory_order_release);
+    }
+}
+
+void EmulatorThread::publish(bool fastForward) {
+    Frame& frame = frames.write();
+    frame.pixels = chip8.pixels;
+    frame.fastForward = fastForward;
+    frame.achievedRate = achievedRate;
+#if CHIP8_PROFILER
+    frame.overlay = overlay;
+#endif
+    frames.publish();
+}
+
+void EmulatorThread::run() {
+    // pace from when the thread starts, not when it was constructed
+    scheduler.resync();
+    bool wasFastForward = false;
+    int framesToPublish = 0;
+#if CHIP8_PROFILER
+    Profiler* profiler = chip8.profiler;
+    bool wasShowingOverlay = false;
+    uint64_t framesToDump = settings.profileInterval * frame_rate;
+    // frames only advance when a frame runs, so remember the last dump
+    // rather than repeat it while rewinding or stopped in the debugger
+    uint64_t lastDump = 0;
+#endif
+
+    while (running.load(std::memory_order_relaxed)) {
+        handleRequests();
+        if (settings.debugger != NULL) {
+            settings.debugger->poll(chip8);
+        }
+        // stopped in the debugger: keep presenting, but run nothing
+        bool halted = settings.debugger != NULL 
+            && settings.debugger->paused();
+        bool stepBack = settings.rewindSeconds > 0 && !halted
+            && rewinding.load(std::memory_order_relaxed);
+        // fast-forward runs frames back to back; timers still tick once
+        // per emulated frame
+        bool unthrottled = (settings.turbo
+            || fastForward.load(std::memory_order_relaxed)) 
+            && !stepBack && !halted;
+        if (unthrottled != wasFastForward) {
+            // restart pacing from now rather than catching up
+            if (!unthrottled) scheduler.resync();
+            wasFastForward = unthrottled;
+            framesToPublish = 0;
+        }
+
+        if (stepBack) {
+            // step back one frame, keeping the live key state
+            rewind.stepBack(chip8);
+            chip8.setKeyMask(keys.load(std::memory_order_relaxed));
+        } else if (halted) {
+            chip8.setKeyMask(keys.load(std::memory_order_relaxed));
+        } else {
+            // logged input replaces the keyboard until it runs out
+            uint16_t keyMask = keys.load(std::memory_order_relaxed);
+            if (settings.replay != NULL) {
+                settings.replay->next(keyMask);
+            }
+            chip8.setKeyMask(keyMask);
+            if (settings.recorder != NULL) {
+                settings.recorder->frame(keyMask);
+            }
+            // run this frame's instructions as one batch, update timers
+            chip8.runFrame();
+            if (settings.rewindSeconds > 0) {
+                rewind.push(chip8);
+            }
+        }
+
+        // muted when fast-forwarding
+        if (settings.audio != NULL) {
+            settings.audio->update(chip8.sTimer > 0 && !unthrottled,
+                chip8.audioPattern, chip8.pitch);
+        }
+
+        // only every nth frame is shown when fast-forwarding
+        if (!unthrottled || framesToPublish-- == 0) {
+            publish(unthrottled);
+            framesToPublish = settings.fastForwardSkip - 1;
+        }
+
+#if CHIP8_PROFILER
+        if (profiler != NULL) {
+            profiler->presentTime(presentNs.exchange(0));
+            if (settings.audio != NULL) {
+                profiler->audioTime(settings.audio->takeBusyTime());
+            }
+            bool show = showOverlay.load(std::memory_order_relaxed);
+            if (show != wasShowingOverlay) {
+                overlay = show ? profiler->overlay() : "";
+                wasShowingOverlay = show;
+            }
+            // periodic stats dump
+            if (framesToDump > 0 && profiler->frames % framesToDump == 0
+                    && profiler->frames != lastDump) {
+                profiler->report(stderr);
+                lastDump = profiler->frames;
+            }
+        }
+#endif
+
+        // sleep until the next 60Hz deadline, unless fast-forwarding
+        if (unthrottled) continue;
+        scheduler.waitForNextFrame();
+        if (scheduler.reportReady()) {
+            achievedRate = scheduler.achievedRate();
+#if CHIP8_PROFILER
+            if (wasShowingOverlay) {
+                overlay = profiler->overlay();
+            }
+#endif
+        }
+    }
+}
@@ -0,0 +1,134 @@
+#ifndef EMULATOR_THREAD_H
+#define EMULATOR_THREAD_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+#include "audio_engine.h"
+#include "chip8.h"
+#include "frame_scheduler.h"
+#include "input_log.h"
+#include "rewind.h"
+#include "snapshot.h"
+#include "triple_buffer.h"
+
+// Runs the core on its own thread, paced by its own 60Hz scheduler. The
+// front end reads finished frames from a triple buffer and sends keys and
+// commands through atomics, so a present that blocks on the compositor
+// never delays the CPU or the timers, and input reaches the next frame.
+// While the thread runs it owns the Chip8; touch it only after stop().
+class EmulatorThread {
+public:
+    static const int frame_rate = 60;
+
+    struct Settings {
+        // seconds of rewind history, 0 to disable
+        int rewindSeconds = 10;
+        // start in fast-forward, and publish every nth frame while in it
+        bool turbo = false;
+        int fastForwardSkip = 10;
+        // input log to play back or write, NULL for none
+        InputReplay* replay = NULL;
+        InputRecorder* recorder = NULL;
+        // quick save file, and the in-memory slot if one was loaded
+        std::string statePath;
+        const Snapshot* snapshot = NULL;
+        // buzzer, fed the sound timer and XO-CHIP pattern every frame
+        AudioEngine* audio = NULL;
+        // polled for commands before every frame, NULL for none
+        Debugger* debugger = NULL;
+#if CHIP8_PROFILER
+        // seconds between profile dumps, 0 for none
+        int profileInterval = 0;
+#endif
+    };
+
+    // what the front end needs to show one frame
+    struct Frame {
+        Framebuffer pixels;
+        bool fastForward = false;
+        // measured frames per second, 0 until the first report
+        double achievedRate = 0;
+#if CHIP8_PROFILER
+        std::string overlay;
+#endif
+    };
+
+    EmulatorThread(Chip8& chip8, const Settings& settings);
+    ~EmulatorThread() { stop(); }
+
+    void start();
+    // finish the current frame and join the thread
+    void stop();
+
+    // front end side, callable from any one thread while running
+    void setKeyMask(uint16_t mask) {
+        keys.store(mask, std::memory_order_relaxed);
+    }
+    void setRewinding(bool held) {
+        rewinding.store(held, std::memory_order_relaxed);
+    }
+    void setFastForward(bool held) {
+        fastForward.store(held, std::memory_order_relaxed);
+    }
+    // quick save / quick load, handled before the next frame
+    void requestSave() { requests.fetch_or(save_request); }
+    void requestLoad() { requests.fetch_or(load_request); }
+    // write the newest quick save to the state file, if one was taken
+    // since the last call; the emulation thread only copies the state
+    void writeSave();
+#if CHIP8_PROFILER
+    void setOverlay(bool show) {
+        showOverlay.store(show, std::memory_order_relaxed);
+    }
+    // time the front end spent presenting, added to the profiler
+    void presentTime(uint64_t ns) {
+        presentNs.fetch_add(ns, std::memory_order_relaxed);
+    }
+#endif
+
+    // newest published frame, false if none since the last call
+    bool newFrame() { return frames.update(); }
+    const Frame& frame() const { return frames.read(); }
+
+    // after stop()
+    Uint64 lateFrames() const { return scheduler.lateFrames(); }
+    const Rewind& history() const { return rewind; }
+
+private:
+    static const int save_request = 1;
+    static const int load_request = 2;
+
+    void run();
+    void handleRequests();
+    void publish(bool fastForward);
+
+    Chip8& chip8;
+    Settings settings;
+    FrameScheduler scheduler;
+    Rewind rewind;
+    Snapshot snapshot;
+    bool haveSnapshot;
+    // copy of a quick save for the front end to write, owned by the
+    // front end while saveReady is set
+    Snapshot saved;
+    std::atomic<bool> saveReady;
+    double achievedRate;
+#if CHIP8_PROFILER
+    std::string overlay;
+    std::atomic<bool> showOverlay;
+    std::atomic<uint64_t> presentNs;
+#endif
+
+    std::atomic<uint16_t> keys;
+    std::atomic<bool> rewinding;
+    std::atomic<bool> fastForward;
+    std::atomic<int> requests;
+    std::atomic<bool> running;
+    TripleBuffer<Frame> frames;
+    std::thread thread;
+};
+
+#endif
@@ -0,0 +1,56 @@
+#include "frame_scheduler.h"
+
+// how far behind we may fall before giving up on catching up
+static const Uint64 max_frames_behind = 5;
+
+FrameScheduler::FrameScheduler(int rate)
+    : rate(rate), start(SDL_GetTicksNS()), frame(0), late(0),
+      windowStart(start), windowFrames(0), achieved(0), 
+      reportPending(false) {
+}
+
+Uint64 FrameScheduler::deadline(Uint64 frameIndex) const {
+    return start + frameIndex * SDL_NS_PER_SECOND / rate;
+}
+
+void FrameScheduler::waitForNextFrame() {
+    frame++;
+    windowFrames++;
+    Uint64 next = deadline(frame);
+    Uint64 now = SDL_GetTicksNS();
+
+    if (now < next) {
+        // SDL sleeps most of the interval and spins the remainder
+        SDL_DelayPrecise(next - now);
+    } else {
+        late++;
+        // stalled (e.g. window dragged), restart the schedule from now 
+        // instead of running a burst of frames to catch up
+        if (now - next > max_frames_behind * SDL_NS_PER_SECOND / rate) {
+            start = now;
+            frame = 0;
+        }
+    }
+
+    now = SDL_GetTicksNS();
+    if (now - windowStart >= SDL_NS_PER_SECOND) {
+        achieved = (double)windowFrames * SDL_NS_PER_SECOND 
+            / (now - windowStart);
+        windowStart = now;
+        windowFrames = 0;
+        reportPending = true;
+    }
+}
+
+void FrameScheduler::resync() {
+    start = SDL_GetTicksNS();
+    frame = 0;
+    windowStart = start;
+    windowFrames = 0;
+}
+
+bool FrameScheduler::reportReady() {
+    bool ready = reportPending;
+    reportPending = false;
+    return ready;
+}
@@ -0,0 +1,39 @@
+#ifndef FRAME_SCHEDULER_H
+#define FRAME_SCHEDULER_H
+
+#include <SDL3/SDL.h>
+
+// Paces the main loop at a fixed frame rate. Deadlines are computed from
+// the start time and frame count, so rounding never accumulates as drift.
+class FrameScheduler {
+public:
+    explicit FrameScheduler(int rate = 60);
+
+    // sleep until the next frame deadline
+    void waitForNextFrame();
+    // restart the schedule from now, e.g. after running unthrottled
+    void resync();
+
+    // true once per second, when a new achieved rate is available
+    bool reportReady();
+    // frames per second measured over the last report interval
+    double achievedRate() const { return achieved; }
+    int targetRate() const { return rate; }
+    // frames that started after their deadline had already passed
+    Uint64 lateFrames() const { return late; }
+
+private:
+    Uint64 deadline(Uint64 frameIndex) const;
+
+    int rate;
+    Uint64 start;
+    Uint64 frame;
+    Uint64 late;
+    // measurement window for achieved rate
+    Uint64 windowStart;
+    Uint64 windowFrames;
+    double achieved;
+    bool reportPending;
+};
+
+#endif
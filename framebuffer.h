@@ -0,0 +1,165 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <cstdint>
+#include <cstring>
+
+// Row-major, bit-packed display of up to four bit planes (XO-CHIP). Each
+// row is up to 128 pixels wide, stored as two 64-bit words; the most
+// significant bit of word 0 is the leftmost pixel. In 64x32 mode only
+// word 0 of the first 32 rows is used. A pixel's color is the 4-bit index
+// made of its bit in each plane, plane 0 lowest.
+class Framebuffer {
+public:
+    static const int max_width = 128;
+    static const int max_height = 64;
+    static const int words_per_row = max_width / 64;
+    static const int max_planes = 4;
+
+    Framebuffer(int width = 64, int height = 32) : planeMask(1) {
+        setResolution(width, height);
+    }
+
+    // switch between 64x32 and 128x64, clearing every plane
+    void setResolution(int w, int h) {
+        width = w;
+        height = h;
+        rowMask[0] = ~0ULL;
+        rowMask[1] = w > 64 ? ~0ULL : 0;
+        std::memset(planes, 0, sizeof(planes));
+    }
+
+    // clear the selected planes
+    void clear() {
+        for (int p = 0; p < max_planes; p++) {
+            if (selected(p)) {
+                std::memset(planes[p], 0, sizeof(planes[p]));
+            }
+        }
+    }
+
+    bool selected(int plane) const {
+        return (planeMask >> plane) & 1;
+    }
+
+    // color index of a pixel
+    int get(int x, int y) const {
+        int color = 0;
+        for (int p = 0; p < max_planes; p++) {
+            color |= ((planes[p][y][x >> 6] >> (63 - (x & 63))) & 1) << p;
+        }
+        return color;
+    }
+
+    // unpack to one 32-bit color per pixel through a 16-entry palette,
+    // pitch in bytes between rows
+    void expand(uint32_t* out, int pitch, const uint32_t* palette) const {
+        for (int y = 0; y < height; y++) {
+            uint32_t* line = (uint32_t*)((uint8_t*)out + y * pitch);
+            for (int x = 0; x < width; x += 64) {
+                uint64_t word[max_planes];
+                for (int p = 0; p < max_planes; p++) {
+                    word[p] = planes[p][y][x >> 6];
+                }
+                uint32_t* pixel = line + x;
+                if ((word[1] | word[2] | word[3]) == 0) {
+                    // plane 0 only, the common case
+                    for (int b = 63; b >= 0; b--) {
+                        *pixel++ = palette[word[0] >> b & 1];
+                    }
+                    continue;
+                }
+                for (int b = 63; b >= 0; b--) {
+                    int color = (word[0] >> b & 1) | (word[1] >> b & 1) << 1
+                        | (word[2] >> b & 1) << 2 | (word[3] >> b & 1) << 3;
+                    *pixel++ = palette[color];
+                }
+            }
+        }
+    }
+
+    // XOR a sprite row onto one plane at column x of row y, clipping at
+    // the right edge. The sprite's pixels are left-aligned in the word,
+    // so 8- and 16-pixel rows share the code. Returns true if any lit
+    // pixel was turned off.
+    bool drawRow(int plane, int x, int y, uint64_t sprite) {
+        uint64_t mask[words_per_row];
+        if (x < 64) {
+            mask[0] = sprite >> x;
+            // two shifts, a single shift by 64 is undefined
+            mask[1] = (sprite << 1) << (63 - x);
+        } else {
+            mask[0] = 0;
+            mask[1] = sprite >> (x - 64);
+        }
+
+        uint64_t* row = planes[plane][y];
+        uint64_t collision = 0;
+        for (int w = 0; w < words_per_row; w++) {
+            uint64_t m = mask[w] & rowMask[w];
+            collision |= row[w] & m;
+            row[w] ^= m;
+        }
+        return collision != 0;
+    }
+
+    // scroll the selected planes by n rows, blank rows move in
+    void scrollDown(int n) {
+        n = n < height ? n : height;
+        for (int p = 0; p < max_planes; p++) {
+            if (selected(p)) {
+                std::memmove(planes[p][n], planes[p][0],
+                    (height - n) * sizeof(planes[p][0]));
+                std::memset(planes[p][0], 0, n * sizeof(planes[p][0]));
+            }
+        }
+    }
+
+    void scrollUp(int n) {
+        n = n < height ? n : height;
+        for (int p = 0; p < max_planes; p++) {
+            if (selected(p)) {
+                std::memmove(planes[p][0], planes[p][n],
+                    (height - n) * sizeof(planes[p][0]));
+                std::memset(planes[p][height - n], 0,
+                    n * sizeof(planes[p][0]));
+            }
+        }
+    }
+
+    // scroll the selected planes sideways by 1-63 pixels, as a 128-bit
+    // shift of each row
+    void scrollRight(int n) {
+        for (int p = 0; p < max_planes; p++) {
+            if (!selected(p)) continue;
+            for (int y = 0; y < height; y++) {
+                uint64_t* row = planes[p][y];
+                row[1] = ((row[1] >> n) | (row[0] << (64 - n))) & rowMask[1];
+                row[0] >>= n;
+            }
+        }
+    }
+
+    void scrollLeft(int n) {
+        for (int p = 0; p < max_planes; p++) {
+            if (!selected(p)) continue;
+            for (int y = 0; y < height; y++) {
+                uint64_t* row = planes[p][y];
+                row[0] = (row[0] << n) | (row[1] >> (64 - n));
+                row[1] = (row[1] << n) & rowMask[1];
+            }
+        }
+    }
+
+    int width;
+    int height;
+    // planes drawn, cleared and scrolled, bit n for plane n (XO-CHIP FN01)
+    uint8_t planeMask;
+    uint64_t planes[max_planes][max_height][words_per_row];
+
+private:
+    // columns that exist at the current resolution
+    uint64_t rowMask[words_per_row];
+};
+
+#endif
@@ -0,0 +1,191 @@
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "chip8.h"
+#include "rewind.h"
+
+// Coverage-guided fuzzing of the interpreter core with arbitrary ROMs and
+// key input. Each input runs a bounded number of frames on every engine,
+// which must agree on the final machine state. The table engine's run is
+// also recorded into a short rewind history and stepped back frame by
+// frame, across keyframes and evicted frames, to check every state comes
+// back unchanged.
+//
+// input layout:
+//   u8 quirk profile (taken modulo the profile count)
+//   u8 n, then n x u16 key masks (little-endian), one per frame, repeated
+//   the rest is the ROM, loaded at 0x200
+//
+// Built as a libFuzzer target with clang (CHIP8_FUZZ=ON); other compilers
+// get a main that replays the files or directories given on the command
+// line, e.g. the fuzz_corpus seeds.
+
+// frames run per engine, 2 seconds of emulated time
+static const int fuzz_frames = 120;
+
+struct FuzzResult {
+    uint64_t framebuffer;
+    TwoByte pc;
+    TwoByte i_reg;
+    std::array<Byte, 16> registers;
+};
+
+// rewind history for the round-trip check, shorter than the run so the
+// oldest frames are evicted
+static const int fuzz_rewind_seconds = 1;
+
+// FNV-1a over the state a rewind must restore
+static uint64_t stateHash(const Chip8& chip8) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    auto add = [&hash](const void* data, size_t size) {
+        for (size_t i = 0; i < size; i++) {
+            hash ^= ((const uint8_t*)data)[i];
+            hash *= 0x100000001b3ULL;
+        }
+    };
+    add(chip8.ram.data(), chip8.memorySize());
+    add(chip8.registers.data(), sizeof(chip8.registers));
+    add(chip8.stack.data(), sizeof(chip8.stack));
+    add(&chip8.pc, sizeof(chip8.pc));
+    add(&chip8.i_reg, sizeof(chip8.i_reg));
+    add(&chip8.sp, sizeof(chip8.sp));
+    add(&chip8.dTimer, sizeof(chip8.dTimer));
+    add(&chip8.sTimer, sizeof(chip8.sTimer));
+    add(chip8.flags.data(), sizeof(chip8.flags));
+    add(&chip8.mt, sizeof(chip8.mt));
+    uint64_t framebuffer = chip8.framebufferHash();
+    add(&framebuffer, sizeof(framebuffer));
+    return hash;
+}
+
+static bool runEngine(Chip8::Engine engine, QuirkProfile profile,
+        const std::vector<uint16_t>& keys, const uint8_t* rom, int size,
+        FuzzResult& result, Rewind* rewind = nullptr) {
+    // 64 kB of RAM, too much for the stack
+    std::unique_ptr<Chip8> chip8(new Chip8());
+    chip8->seed(1);
+    chip8->engine = engine;
+    chip8->profile = profile;
+    chip8->loadFont();
+    if (chip8->loadProgram(rom, size) != 0) {
+        return false;
+    }
+    std::vector<uint64_t> history;
+    for (int frame = 0; frame < fuzz_frames; frame++) {
+        chip8->setKeyMask(keys.empty() ? 0 : keys[frame % keys.size()]);
+        chip8->runFrame();
+        if (rewind != nullptr) {
+            rewind->push(*chip8);
+            history.push_back(stateHash(*chip8));
+        }
+    }
+    result.framebuffer = chip8->framebufferHash();
+    result.pc = chip8->pc;
+    result.i_reg = chip8->i_reg;
+    result.registers = chip8->registers;
+
+    if (rewind != nullptr) {
+        // stepping back must land on exactly the recorded states
+        int frame = fuzz_frames - 1;
+        while (rewind->stepBack(*chip8)) {
+            frame--;
+            if (stateHash(*chip8) != history[frame]) {
+                std::fprintf(stderr, "Rewind to frame %d does not match"
+                    " the recorded state.\n", frame);
+                std::abort();
+            }
+        }
+    }
+    return true;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    if (size < 2) {
+        return 0;
+    }
+    QuirkProfile profile = (QuirkProfile)(data[0] % quirk_profile_count);
+    size_t keyCount = data[1];
+    if (size < 2 + 2 * keyCount) {
+        return 0;
+    }
+    std::vector<uint16_t> keys(keyCount);
+    for (size_t i = 0; i < keyCount; i++) {
+        keys[i] = data[2 + 2 * i] | data[3 + 2 * i] << 8;
+    }
+    const uint8_t* rom = data + 2 + 2 * keyCount;
+    int romSize = size - 2 - 2 * keyCount;
+
+    const Chip8::Engine engines[] = { Chip8::Engine::Table,
+        Chip8::Engine::Threaded, Chip8::Engine::Blocks };
+    FuzzResult first;
+    // the arena is sized up front, so one history serves every input
+    static Rewind rewind(fuzz_rewind_seconds);
+    for (int e = 0; e < 3; e++) {
+        FuzzResult result;
+        rewind.clear();
+        if (!runEngine(engines[e], profile, keys, rom, romSize, result,
+                e == 0 ? &rewind : nullptr)) {
+            // too large for the profile
+            return 0;
+        }
+        if (e == 0) {
+            first = result;
+        } else if (result.framebuffer != first.framebuffer
+                || result.pc != first.pc || result.i_reg != first.i_reg
+                || result.registers != first.registers) {
+            std::fprintf(stderr, "Engine %d disagrees with the table engine"
+                " (pc %04X / %04X).\n", e, result.pc, first.pc);
+            std::abort();
+        }
+    }
+    return 0;
+}
+
+#ifndef CHIP8_LIBFUZZER
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+static int runFile(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Could not open " << path.string() << ".\n";
+        return 1;
+    }
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)),
+        std::istreambuf_iterator<char>());
+    LLVMFuzzerTestOneInput(data.data(), data.size());
+    return 0;
+}
+
+int main(int argc, char* args[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: chip-8-fuzz input|directory...\n";
+        return EXIT_FAILURE;
+    }
+    int failed = 0;
+    int count = 0;
+    for (int i = 1; i < argc; i++) {
+        std::error_code error;
+        if (std::filesystem::is_directory(args[i], error)) {
+            for (const auto& entry
+                    : std::filesystem::directory_iterator(args[i])) {
+                if (entry.is_regular_file()) {
+                    failed += runFile(entry.path());
+                    count++;
+                }
+            }
+        } else {
+            failed += runFile(args[i]);
+            count++;
+        }
+    }
+    std::printf("%d inputs run\n", count - failed);
+    return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+#endif
@@ -0,0 +1,137 @@
+#include "input_log.h"
+
+#include <cstring>
+#include <iostream>
+#include <iterator>
+
+static const char input_log_magic[4] = { 'C', 'H', '8', 'R' };
+
+namespace {
+
+void put(std::ofstream& file, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        file.put((char)((value >> (8 * i)) & 0xFF));
+    }
+}
+
+uint64_t get(const std::vector<uint8_t>& in, size_t& pos, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) {
+        value |= (uint64_t)in[pos++] << (8 * i);
+    }
+    return value;
+}
+
+}
+
+int InputRecorder::open(const char* path, uint32_t seed, 
+        uint64_t programHash, uint16_t instructionsPerFrame,
+        uint8_t quirkProfile) {
+    file.open(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Input log could not be created.\n";
+        return 1;
+    }
+    file.write(input_log_magic, 4);
+    put(file, input_log_version, 2);
+    put(file, seed, 4);
+    put(file, programHash, 8);
+    put(file, instructionsPerFrame, 2);
+    put(file, quirkProfile, 1);
+    runLength = 0;
+    return 0;
+}
+
+void InputRecorder::writeRun() {
+    put(file, runLength, 4);
+    put(file, runMask, 2);
+}
+
+void InputRecorder::frame(uint16_t keyMask) {
+    if (runLength > 0 && (keyMask != runMask || runLength == UINT32_MAX)) {
+        writeRun();
+        runLength = 0;
+    }
+    runMask = keyMask;
+    runLength++;
+}
+
+int InputRecorder::close() {
+    if (!file.is_open()) {
+        return 0;
+    }
+    if (runLength > 0) {
+        writeRun();
+        runLength = 0;
+    }
+    file.close();
+    if (!file) {
+        std::cerr << "Input log could not be written.\n";
+        return 1;
+    }
+    return 0;
+}
+
+int InputReplay::open(const char* path) {
+    std::ifstream file {path, std::ios::binary};
+    if (!file) {
+        std::cerr << "Input log could not be opened.\n";
+        return 1;
+    }
+    std::vector<uint8_t> in { std::istreambuf_iterator<char>(file),
+        std::istreambuf_iterator<char>() };
+
+    const size_t header_size = 4 + 2 + 4 + 8;
+    const size_t settings_size = 2 + 1;
+    const size_t run_size = 4 + 2;
+    if (in.size() < header_size 
+            || std::memcmp(in.data(), input_log_magic, 4) != 0) {
+        std::cerr << "Not an input log file.\n";
+        return 1;
+    }
+    size_t pos = 4;
+    uint64_t version = get(in, pos, 2);
+    if (version < 1 || version > input_log_version
+            || (version >= 2 && in.size() < header_size + settings_size)) {
+        std::cerr << "Unsupported input log version.\n";
+        return 1;
+    }
+    logSeed = get(in, pos, 4);
+    logProgramHash = get(in, pos, 8);
+    logInstructionsPerFrame = 15;
+    logQuirkProfile = 0;
+    if (version >= 2) {
+        logInstructionsPerFrame = get(in, pos, 2);
+        logQuirkProfile = get(in, pos, 1);
+    }
+    if ((in.size() - pos) % run_size != 0) {
+        std::cerr << "Input log is truncated.\n";
+        return 1;
+    }
+
+    runs.clear();
+    totalFrames = 0;
+    while (pos < in.size()) {
+        Run r;
+        r.length = get(in, pos, 4);
+        r.mask = get(in, pos, 2);
+        runs.push_back(r);
+        totalFrames += r.length;
+    }
+    run = 0;
+    played = 0;
+    return 0;
+}
+
+bool InputReplay::next(uint16_t& keyMask) {
+    while (run < runs.size() && played >= runs[run].length) {
+        run++;
+        played = 0;
+    }
+    if (run >= runs.size()) {
+        return false;
+    }
+    keyMask = runs[run].mask;
+    played++;
+    return true;
+}
@@ -0,0 +1,68 @@
+#ifndef INPUT_LOG_H
+#define INPUT_LOG_H
+
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+// Recorded session: the PRNG seed, the loaded program's hash, the speed
+// and quirk settings and the key state of every frame. Together with the
+// ROM that is everything needed to re-execute a session bit-exactly.
+//
+// file layout (little-endian):
+//   "CH8R" magic, u16 version, u32 seed, u64 program hash,
+//   u16 instructions per frame, u8 quirk profile
+//   records of u32 frame count, u16 key bitmask (one per run of frames
+//   with unchanged keys)
+// version 1 logs have no speed or quirk fields (15 per frame, COSMAC VIP).
+const uint16_t input_log_version = 2;
+
+class InputRecorder {
+public:
+    // start a log, returns 0 on success
+    int open(const char* path, uint32_t seed, uint64_t programHash,
+        uint16_t instructionsPerFrame, uint8_t quirkProfile);
+    // key state used for the next frame
+    void frame(uint16_t keyMask);
+    // flush the last run, returns 0 on success
+    int close();
+
+private:
+    void writeRun();
+
+    std::ofstream file;
+    uint16_t runMask = 0;
+    uint32_t runLength = 0;
+};
+
+class InputReplay {
+public:
+    // load a whole log, returns 0 on success
+    int open(const char* path);
+
+    uint32_t seed() const { return logSeed; }
+    uint64_t programHash() const { return logProgramHash; }
+    uint16_t instructionsPerFrame() const { return logInstructionsPerFrame; }
+    uint8_t quirkProfile() const { return logQuirkProfile; }
+    long long frames() const { return totalFrames; }
+
+    // key state for the next frame, false once the log is exhausted
+    bool next(uint16_t& keyMask);
+
+private:
+    struct Run {
+        uint32_t length;
+        uint16_t mask;
+    };
+
+    uint32_t logSeed = 0;
+    uint64_t logProgramHash = 0;
+    uint16_t logInstructionsPerFrame = 15;
+    uint8_t logQuirkProfile = 0;
+    long long totalFrames = 0;
+    std::vector<Run> runs;
+    size_t run = 0;
+    uint32_t played = 0;
+};
+
+#endif
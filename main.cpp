@@ -1,56 +1,25 @@
-#include <fstream>
 #include <iostream>
-#include <vector>
-#include <string>
-#include <random>
+#include <array>
 #include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_main.h>
-
-using Byte = uint8_t;
-using Nibble = Byte;
-using TwoByte = uint16_t;
-
-// store font data in memory (050-09F)
-int loadFont(std::vector<Byte> &ram) {
-    // open file
-    std::ifstream file {"fonts/font.txt"};
-    if(!file) {
-        std::cerr << "Font file could not be opened.\n";
-        // HANDLE ERROR
-        return 1;
-    }
-
-    std::string strInput{};
-    int i = 0x50;
-    while (file >> strInput) {
-        ram[i++] = std::stoi(strInput, 0, 16);
-    }
-    return 0;
-}
-
-// load program into memory at 0x200
-int loadProgram(std::vector<Byte> &ram, int &programSize, const char* path) {
-    std::ifstream programFile {path, std::ios::binary};
-    if(!programFile) {
-        std::cerr << "Program file could not be opened.\n";
-        // HANDLE ERROR
-        return 1;
-    }
-    // determine file length
-    programFile.seekg(0, programFile.end);
-    programSize = programFile.tellg();
-    programFile.seekg(0, programFile.beg);
-    
-    for (int i = 0x200; i < programSize + 0x200; i++) {
-        programFile.read((char*) &ram[i], sizeof(Byte));
-    }
-    return 0;
-}
+#include "audio_engine.h"
+#include "chip8.h"
+#include "debug_console.h"
+#include "emulator_thread.h"
+#include "input_log.h"
+#include "screen_renderer.h"
+#include "rewind.h"
+#include "rom_database.h"
+#include "snapshot.h"
 
 bool initSDL(SDL_Window*& window, SDL_Renderer*& renderer, 
-        SDL_AudioStream*& audioStream, Uint8*& wav_data, Uint32& wav_data_len,
-        int width, int height) {
+        AudioEngine& audio, int width, int height) {
     // Initialization flag
     bool success = true;
 
@@ -70,26 +39,18 @@ bool initSDL(SDL_Window*& window, SDL_Renderer*& renderer,
             renderer = SDL_CreateRenderer(window, NULL);
         }
 
-        // Initialize audio
-        SDL_AudioSpec spec;
-        if (!SDL_LoadWAV("sounds/beep.wav",
-                &spec, &wav_data, &wav_data_len)) {
-            SDL_Log("Couldn't load .wav file: %s", SDL_GetError());
-            success = false;
-        }
-        audioStream = SDL_OpenAudioDeviceStream(
-            SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, &spec, NULL, NULL);
-        if (!audioStream) {
-            SDL_Log("Couldn't create audio stream: %s", SDL_GetError());
+        // Initialize audio, synthesized so there is no asset to load
+        if (!audio.open()) {
             success = false;
         }
     }
     return success;
 }
 
-void closeSDL(SDL_Window*& window, SDL_Renderer*& renderer, Uint8*& wav_data) {
-    SDL_free(wav_data);
-    
+void closeSDL(SDL_Window*& window, SDL_Renderer*& renderer, 
+        AudioEngine& audio) {
+    audio.close();
+
     // Destroy renderer
     SDL_DestroyRenderer(renderer);
     renderer = NULL;
@@ -102,124 +63,342 @@ void closeSDL(SDL_Window*& window, SDL_Renderer*& renderer, Uint8*& wav_data) {
     SDL_Quit();
 }
 
-void clearScreen (std::vector<std::vector<bool>> & pixels,
-                    SDL_Renderer* renderer) {
-    std::fill(pixels.begin(), pixels.end(), 
-        std::vector<bool>(64, false));
-    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
-    SDL_RenderClear(renderer);
-    SDL_RenderPresent(renderer);
+// host key for each CHIP-8 key 0-F, the usual 1234/QWER/ASDF/ZXCV block
+using Keymap = std::array<SDL_Keycode, 16>;
+const Keymap default_keymap = {
+    SDLK_X, SDLK_1, SDLK_2, SDLK_3, SDLK_Q, SDLK_W, SDLK_E, SDLK_A,
+    SDLK_S, SDLK_D, SDLK_Z, SDLK_C, SDLK_4, SDLK_R, SDLK_F, SDLK_V
+};
+
+// CHIP-8 key for a host key, -1 if it is not mapped
+int mapKeyToValue(SDL_Keycode key, const Keymap& keymap) {
+    for (int i = 0; i < 16; i++) {
+        if (keymap[i] == key) return i;
+    }
+    return -1;
 }
 
-void updateScreen (const std::vector<std::vector<bool>> & pixels, 
-                    int w, int h, SDL_Renderer* renderer) {
-    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
-    SDL_RenderClear(renderer);
-    SDL_SetRenderDrawColor(renderer, 0xFF, 0xFF, 0xFF, 0xFF);
-    for (int i = 0; i < w; i++) {
-        for (int j = 0; j < h; j++) {
-            if (pixels[i][j]) {
-                SDL_FRect rect = {
-                    (float)i * 10, // x coordinate
-                    (float)j * 10, // y coordinate
-                    9, // width
-                    10 // height 
-                };
-                SDL_RenderFillRect(renderer, &rect);
-            }
+// run without window or audio for a fixed number of instructions (or the
+// frames of a replayed input log), then print the final framebuffer hash 
+// and register state
+int runHeadless(Chip8 &chip8, long long cycles, InputReplay* replay) {
+    auto start = std::chrono::steady_clock::now();
+    if (replay != NULL) {
+        // replay as fast as possible, stopping at cycles if given
+        uint16_t keyMask;
+        long long limit = cycles;
+        cycles = 0;
+        while ((limit <= 0 || cycles < limit) && replay->next(keyMask)) {
+            chip8.setKeyMask(keyMask);
+            chip8.runFrame();
+            cycles += chip8.instructionsPerFrame;
+        }
+    } else {
+        // timers still tick in emulated time
+        for (long long n = cycles / chip8.instructionsPerFrame; 
+                n > 0; n--) {
+            chip8.runFrame();
         }
+        chip8.run(cycles % chip8.instructionsPerFrame);
+    }
+    std::chrono::duration<double> elapsed = 
+        std::chrono::steady_clock::now() - start;
+
+    std::printf("cycles: %lld\n", cycles);
+    std::printf("framebuffer: %016llx\n",
+        (unsigned long long)chip8.framebufferHash());
+    std::printf("pc: %03X i: %03X dt: %02X st: %02X\n",
+        chip8.pc, chip8.i_reg, chip8.dTimer, chip8.sTimer);
+    for (int i = 0; i < 16; i++) {
+        std::printf("V%X: %02X%c", i, chip8.registers[i], 
+            i % 8 == 7 ? '\n' : ' ');
     }
-    SDL_RenderPresent(renderer);
+    if (elapsed.count() > 0) {
+        std::cerr << "instructions per second: " 
+            << (long long)(cycles / elapsed.count()) << "\n";
+    }
+#if CHIP8_PROFILER
+    if (chip8.profiler != NULL) {
+        chip8.profiler->report(stderr);
+    }
+#endif
+    return 0;
 }
 
-Nibble mapKeyToValue(SDL_Keycode key) {
-    switch (key) 
-    {
-        case SDLK_1: return 1;
-        case SDLK_2: return 2;
-        case SDLK_3: return 3;
-        case SDLK_4: return 0xC;
-        case SDLK_Q: return 4;
-        case SDLK_W: return 5;
-        case SDLK_E: return 6;
-        case SDLK_R: return 0xD;
-        case SDLK_A: return 7;
-        case SDLK_S: return 8;
-        case SDLK_D: return 9;
-        case SDLK_F: return 0xE;
-        case SDLK_Z: return 0xA;
-        case SDLK_X: return 0;
-        case SDLK_C: return 0xB;
-        case SDLK_V: return 0xF;
-        default: return -1;
+// command line settings
+struct Options {
+    const char* path = NULL;
+    // headless mode flags
+    bool headless = false;
+    long long cycles = 0;
+    Chip8::Engine engine = Chip8::Engine::Threaded;
+    QuirkProfile profile = QuirkProfile::CosmacVip;
+    // per-ROM settings, used unless given on the command line
+    const char* romDatabase = NULL;
+    bool quirksGiven = false;
+    bool speedGiven = false;
+    // CPU speed, instructions per 60Hz frame
+    int instructionsPerFrame = Chip8::instructions_per_frame;
+    // start in fast-forward, and present every nth frame while in it
+    bool turbo = false;
+    int fastForwardSkip = 10;
+    // debugger commands from stdin, or a localhost port if not 0
+    bool debug = false;
+    int debugPort = 0;
+    // font file replacing the built-in one
+    const char* font = NULL;
+    // save state to start from, and where to write one
+    const char* loadState = NULL;
+    const char* saveState = NULL;
+    // seconds of rewind history, 0 to disable
+    int rewindSeconds = 10;
+    // input log to write or play back, and PRNG seed
+    const char* record = NULL;
+    const char* replay = NULL;
+    const char* seed = NULL;
+#if CHIP8_PROFILER
+    // seconds between profile dumps, 0 for the exit report only, -1 off
+    int profileInterval = -1;
+#endif
+};
+
+bool parseArgs(int argc, char* args[], Options& options) {
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (std::strcmp(args[i], "--headless") == 0) {
+            options.headless = true;
+        } else if (std::strcmp(args[i], "--cycles") == 0 && hasValue) {
+            options.cycles = std::atoll(args[++i]);
+        } else if (std::strcmp(args[i], "--engine") == 0 && hasValue) {
+            i++;
+            if (std::strcmp(args[i], "table") == 0) {
+                options.engine = Chip8::Engine::Table;
+            } else if (std::strcmp(args[i], "threaded") == 0) {
+                options.engine = Chip8::Engine::Threaded;
+            } else if (std::strcmp(args[i], "blocks") == 0) {
+                options.engine = Chip8::Engine::Blocks;
+            } else {
+                return false;
+            }
+        } else if (std::strcmp(args[i], "--quirks") == 0 && hasValue) {
+            if (!parseQuirkProfile(args[++i], options.profile)) {
+                return false;
+            }
+            options.quirksGiven = true;
+        } else if (std::strcmp(args[i], "--rom-db") == 0 && hasValue) {
+            options.romDatabase = args[++i];
+        } else if (std::strcmp(args[i], "--ipf") == 0 && hasValue) {
+            options.instructionsPerFrame = std::atoi(args[++i]);
+            options.speedGiven = true;
+        } else if (std::strcmp(args[i], "--cps") == 0 && hasValue) {
+            // cycles per second, rounded to whole frames
+            options.instructionsPerFrame = (std::atoi(args[++i]) + 30) / 60;
+            options.speedGiven = true;
+        } else if (std::strcmp(args[i], "--turbo") == 0) {
+            options.turbo = true;
+        } else if (std::strcmp(args[i], "--ff-skip") == 0 && hasValue) {
+            options.fastForwardSkip = std::atoi(args[++i]);
+        } else if (std::strcmp(args[i], "--debug") == 0) {
+            options.debug = true;
+        } else if (std::strcmp(args[i], "--debug-port") == 0 && hasValue) {
+            options.debug = true;
+            options.debugPort = std::atoi(args[++i]);
+        } else if (std::strcmp(args[i], "--font") == 0 && hasValue) {
+            options.font = args[++i];
+        } else if (std::strcmp(args[i], "--load-state") == 0 && hasValue) {
+            options.loadState = args[++i];
+        } else if (std::strcmp(args[i], "--save-state") == 0 && hasValue) {
+            options.saveState = args[++i];
+        } else if (std::strcmp(args[i], "--rewind") == 0 && hasValue) {
+            options.rewindSeconds = std::atoi(args[++i]);
+        } else if (std::strcmp(args[i], "--record") == 0 && hasValue) {
+            options.record = args[++i];
+        } else if (std::strcmp(args[i], "--replay") == 0 && hasValue) {
+            options.replay = args[++i];
+        } else if (std::strcmp(args[i], "--seed") == 0 && hasValue) {
+            options.seed = args[++i];
+#if CHIP8_PROFILER
+        } else if (std::strcmp(args[i], "--profile") == 0 && hasValue) {
+            options.profileInterval = std::atoi(args[++i]);
+#endif
+        } else if (options.path == NULL) {
+            options.path = args[i];
+        } else {
+            return false;
+        }
     }
+    // recordings always start from boot
+    bool logging = options.record != NULL || options.replay != NULL;
+    return options.path != NULL 
+        && options.instructionsPerFrame > 0
+        && options.instructionsPerFrame <= 0xFFFF
+        && options.fastForwardSkip > 0
+        && (!options.headless || options.cycles > 0 
+            || options.replay != NULL)
+        && !(options.record != NULL && options.replay != NULL)
+        && !(logging && options.loadState != NULL)
+        && !(logging && options.debug)
+        && !(options.headless && options.debug)
+        && !(options.headless && options.record != NULL);
 }
 
 int main(int argc, char* args[]) {
+    Chip8 chip8;
+    Options options;
 
-    // 4 kB RAM (program should be loaded at 512 or 0x200)
-    std::vector<Byte> ram (4096);
-    // PC (16-bit, 12-bit actual)
-    TwoByte pc;
-    // 16-bit index register (I)
-    TwoByte i_reg;
-    // 16-bit stack
-    std::vector<TwoByte> stack (16); // 16 levels of nesting
-    // 8-bit delay timer
-    Byte delay_timer;
-    // 8-bit sound timer
-    Byte sound_timer;
-    // 16 8-bit variable registers (V0 - VF)
-    std::vector<Byte> registers (16);
-    // Delay and sound timers
-    Byte dTimer = 0;
-    Byte sTimer = 0;
-    // screen dimensions
-    const int screen_width = 64;
-    const int screen_height = 32;
-    // pixels' on / off states
-    std::vector< std::vector<bool> > pixels (
-        screen_width, std::vector<bool>(screen_height, false));
-    // vector for key values
-    std::vector<bool> keys (16, false);
-    // last key pressed
-    int lastKey = -1;
-    // size of loaded program
-    int programSize;
-    // timer variables
-    unsigned int lastUpdate = 0, currentTime;
-    // instantiate PRNG engine
-    std::mt19937 mt{std::chrono::steady_clock::now().time_since_epoch().count()};
-
-    if (loadFont(ram) != 0) return EXIT_FAILURE;
-
-    if (argc == 2) {
-        if (loadProgram(ram, programSize, args[1]) != 0) 
+    if (!parseArgs(argc, args, options)) {
+        std::cerr << "Usage: chip-8 [--headless --cycles N] "
+            "[--engine table|threaded|blocks]\n"
+            "              [--quirks vip|chip48|schip|xochip|amiga] "
+            "[--rom-db file]\n"
+            "              [--ipf N | --cps N] [--turbo] [--ff-skip N] "
+            "[--font file]\n"
+            "              [--debug | --debug-port N]\n"
+            "              [--load-state file] [--save-state file] "
+            "[--rewind seconds]\n"
+            "              [--record file | --replay file] [--seed N] "
+#if CHIP8_PROFILER
+            "[--profile seconds] "
+#endif
+            "[path]\n";
+        return EXIT_FAILURE;
+    }
+    chip8.engine = options.engine;
+    chip8.profile = options.profile;
+    chip8.instructionsPerFrame = options.instructionsPerFrame;
+#if CHIP8_PROFILER
+    Profiler profiler;
+    if (options.profileInterval >= 0) {
+        chip8.profiler = &profiler;
+    }
+#endif
+
+    chip8.loadFont();
+    if (options.font != NULL && chip8.loadFont(options.font) != 0) {
+        return EXIT_FAILURE;
+    }
+
+    // read the ROM once, then look its hash up before loading: the quirk
+    // profile decides how large a program may be
+    std::vector<Byte> program;
+    if (Chip8::readProgram(options.path, program) != 0) return EXIT_FAILURE;
+    Keymap keymap = default_keymap;
+    if (options.romDatabase != NULL) {
+        RomDatabase database;
+        if (database.open(options.romDatabase) != 0) return EXIT_FAILURE;
+        RomSettings rom;
+        if (database.find(Chip8::hashProgram(program.data(), 
+                program.size()), rom)) {
+            if (!options.quirksGiven) {
+                chip8.profile = rom.profile;
+            }
+            if (!options.speedGiven && rom.instructionsPerFrame > 0) {
+                chip8.instructionsPerFrame = rom.instructionsPerFrame;
+            }
+            if (rom.hasKeymap) {
+                // lowercase letters and digits are their own keycodes
+                for (int i = 0; i < 16; i++) {
+                    keymap[i] = (SDL_Keycode)rom.keymap[i];
+                }
+            }
+        }
+    }
+
+    // a replay only matches at the speed and quirks it was recorded with,
+    // and the profile decides how large a program may be, so the log is
+    // read before loading
+    InputReplay replay;
+    InputRecorder recorder;
+    if (options.replay != NULL) {
+        if (replay.open(options.replay) != 0) return EXIT_FAILURE;
+        if (replay.programHash() != Chip8::hashProgram(program.data(),
+                program.size())) {
+            std::cerr << "Input log was recorded with a different program.\n";
             return EXIT_FAILURE;
-    } else {
-        std::cerr << "Usage: chip-8 [path]\n";
+        }
+        if (replay.quirkProfile() >= quirk_profile_count
+                || replay.instructionsPerFrame() == 0) {
+            std::cerr << "Input log has invalid speed or quirk settings.\n";
+            return EXIT_FAILURE;
+        }
+        chip8.instructionsPerFrame = replay.instructionsPerFrame();
+        chip8.profile = (QuirkProfile)replay.quirkProfile();
+    }
+    if (chip8.loadProgram(program.data(), program.size()) != 0) {
         return EXIT_FAILURE;
     }
 
-    pc = 0x200;
+    // seed the PRNG so recorded sessions can be re-executed exactly
+    if (options.replay != NULL) {
+        chip8.seed(replay.seed());
+    } else if (options.seed != NULL || options.record != NULL) {
+        uint32_t seed = options.seed != NULL 
+            ? (uint32_t)std::strtoul(options.seed, NULL, 0)
+            : (uint32_t)std::chrono::steady_clock::now()
+                .time_since_epoch().count();
+        chip8.seed(seed);
+        if (options.record != NULL && recorder.open(options.record, seed,
+                chip8.programHash(), chip8.instructionsPerFrame,
+                (uint8_t)chip8.profile) != 0) {
+            return EXIT_FAILURE;
+        }
+    }
+    // rewinding or loading would make the log diverge from what ran
+    bool logging = options.record != NULL || options.replay != NULL;
+    if (logging) {
+        options.rewindSeconds = 0;
+    }
+
+    // quick save slot, also used to resume from a state file
+    Snapshot snapshot;
+    bool haveSnapshot = false;
+    if (options.loadState != NULL) {
+        if (readSnapshot(snapshot, options.loadState) != 0) {
+            return EXIT_FAILURE;
+        }
+        if (!snapshotFits(snapshot, chip8)) {
+            std::cerr << "Save state was made with a different quirk "
+                "profile.\n";
+            return EXIT_FAILURE;
+        }
+        chip8.restore(snapshot);
+        haveSnapshot = true;
+    }
+
+    if (options.headless) {
+        int result = runHeadless(chip8, options.cycles, 
+            options.replay != NULL ? &replay : NULL);
+        if (result == 0 && options.saveState != NULL) {
+            chip8.save(snapshot);
+            result = writeSnapshot(snapshot, options.saveState);
+        }
+        return result;
+    }
+
+    // the emulation thread takes over the machine from here
+    EmulatorThread::Settings settings;
+    settings.rewindSeconds = options.rewindSeconds;
+    settings.turbo = options.turbo;
+    settings.fastForwardSkip = options.fastForwardSkip;
+    settings.replay = options.replay != NULL ? &replay : NULL;
+    settings.recorder = options.record != NULL ? &recorder : NULL;
+    // F5 writes here, defaults to next to the ROM
+    settings.statePath = options.saveState != NULL 
+        ? options.saveState : std::string(options.path) + ".state";
+    settings.snapshot = haveSnapshot ? &snapshot : NULL;
+#if CHIP8_PROFILER
+    settings.profileInterval = options.profileInterval;
+#endif
 
     // SDL stuff
     SDL_Window* window = NULL;
     SDL_Renderer* renderer;
-    // struct for drawing rects as pixels 
-    SDL_FRect rect = {
-        0, // x coordinate
-        0, // y coordinate
-        10, // width
-        10, // height
-    };
     // SDL audio
-    SDL_AudioStream *audioStream = NULL;
-    Uint8 *wav_data = NULL;
-    Uint32 wav_data_len = 0;
+    AudioEngine audio;
+    settings.audio = &audio;
 
-    if (!initSDL(window, renderer, audioStream, wav_data, wav_data_len,
-            screen_width * 10, screen_height * 10)) {
+    if (!initSDL(window, renderer, audio,
+            Chip8::screen_width * 10, Chip8::screen_height * 10)) {
         SDL_Log("Failed to initialize!\n");
     } else {        
         // Main loop flag
@@ -228,345 +407,135 @@ int main(int argc, char* args[]) {
         // Event handler
         SDL_Event e;
 
-        // instructions counter
-        int instr_counter = 0;
+        // framebuffer to window
+        ScreenRenderer screen(renderer);
+
+        // commands from stdin or a socket, run by the emulation thread;
+        // starts stopped so breakpoints can go in before the first frame
+        DebugConsole console;
+        Debugger debugger([&console](const std::string& text) {
+            console.write(text);
+        });
+        if (options.debug) {
+            if (console.open(options.debugPort, [&debugger](
+                    const std::string& line) { debugger.post(line); }) != 0) {
+                quit = true;
+            }
+            debugger.post("pause");
+            settings.debugger = &debugger;
+        }
+
+        // the CPU, timers and sound gate run on their own thread, this
+        // one only handles input and drawing
+        EmulatorThread emulator(chip8, settings);
+        emulator.start();
+        uint16_t keyMask = 0;
+        bool wasFastForward = false;
+        double shownRate = 0;
+#if CHIP8_PROFILER
+        // F3 toggles the stats overlay while profiling
+        bool showOverlay = false;
+#endif
 
         while (!quit) {
-            
-            // Update screen and timer (60Hz)
-            currentTime = SDL_GetTicks();
-            if (currentTime > lastUpdate + 16.66) {
-                // reset instructions counter
-                instr_counter = 0;
-
-                // update screen
-                updateScreen(pixels, screen_width, screen_height, renderer);
-                // Update timers
-                if (dTimer > 0) dTimer--;
-                if (sTimer > 0) {
-                    SDL_ResumeAudioStreamDevice(audioStream);
-                    // update audio stream
-                    if(SDL_GetAudioStreamQueued(audioStream) < (int)wav_data_len) {
-                        SDL_PutAudioStreamData(audioStream, wav_data, wav_data_len);
-                    }
-                    sTimer--;
-                } else {
-                    SDL_PauseAudioStreamDevice(audioStream);
-                }
-                
-                lastUpdate = currentTime;
-                
-                // Check for input
-                while (SDL_PollEvent(&e) != 0) {
-                    if (e.type == SDL_EVENT_QUIT) {
-                        quit = true;
-                    } else if (e.type == SDL_EVENT_KEY_DOWN) {
-                        int key_val = mapKeyToValue(e.key.key);
-                        if (key_val != -1) keys[key_val] = true;
-                    } else if (e.type == SDL_EVENT_KEY_UP) {
-                        int key_val = mapKeyToValue(e.key.key);
-                        if (key_val != -1) keys[key_val] = false;
-                    }
+            // Check for input
+            while (SDL_PollEvent(&e) != 0) {
+                if (e.type == SDL_EVENT_QUIT) {
+                    quit = true;
+                } else if (e.type == SDL_EVENT_WINDOW_EXPOSED) {
+                    screen.invalidate();
+                } else if (e.type == SDL_EVENT_KEY_DOWN 
+                        && e.key.key == SDLK_F5) {
+                    emulator.requestSave();
+                } else if (e.type == SDL_EVENT_KEY_DOWN 
+                        && e.key.key == SDLK_F9 && !logging) {
+                    emulator.requestLoad();
+                } else if (e.type == SDL_EVENT_KEY_DOWN 
+                        && e.key.key == SDLK_BACKSPACE) {
+                    emulator.setRewinding(true);
+                } else if (e.type == SDL_EVENT_KEY_UP 
+                        && e.key.key == SDLK_BACKSPACE) {
+                    emulator.setRewinding(false);
+                } else if (e.type == SDL_EVENT_KEY_DOWN 
+                        && e.key.key == SDLK_TAB) {
+                    emulator.setFastForward(true);
+                } else if (e.type == SDL_EVENT_KEY_UP 
+                        && e.key.key == SDLK_TAB) {
+                    emulator.setFastForward(false);
+#if CHIP8_PROFILER
+                } else if (e.type == SDL_EVENT_KEY_DOWN 
+                        && e.key.key == SDLK_F3 && chip8.profiler != NULL) {
+                    showOverlay = !showOverlay;
+                    emulator.setOverlay(showOverlay);
+#endif
+                } else if (e.type == SDL_EVENT_KEY_DOWN) {
+                    int key_val = mapKeyToValue(e.key.key, keymap);
+                    if (key_val >= 0) keyMask |= 1 << key_val;
+                    emulator.setKeyMask(keyMask);
+                } else if (e.type == SDL_EVENT_KEY_UP) {
+                    int key_val = mapKeyToValue(e.key.key, keymap);
+                    if (key_val >= 0) keyMask &= ~(1 << key_val);
+                    emulator.setKeyMask(keyMask);
                 }
             }
+            // F5 state files are written here, not on the CPU's thread
+            emulator.writeSave();
 
-            // limit instructions per frame
-            if (instr_counter >= 15) {
+            if (!emulator.newFrame()) {
+                // nothing new to draw, wait for input instead of spinning
+                SDL_WaitEventTimeout(NULL, 1);
                 continue;
             }
+            const EmulatorThread::Frame& frame = emulator.frame();
 
-            // decode instruction
-            Nibble first_nibble = (ram[pc] & 0xF0) >> 4;
-            Nibble second_nibble = ram[pc++] & 0x0F;
-            Nibble third_nibble = (ram[pc] & 0xF0) >> 4;
-            Nibble fourth_nibble = ram[pc++] & 0x0F;
-            
-            switch(first_nibble) 
-            {
-            case 0:
-                if (second_nibble == 0 && third_nibble == 0xE 
-                        && fourth_nibble == 0x0) { 
-                    // clear the screen
-                    clearScreen(pixels, renderer);
-                } else if (second_nibble == 0 && third_nibble == 0xE 
-                        && fourth_nibble == 0xE) { 
-                    // return
-                    pc = stack.back();
-                    stack.pop_back();
-                } else { 
-                    // call machine code routine at NNN
-                }
-                break;
-            case 1: // jump (set pc to NNN)
-                pc = (second_nibble << 8) | (third_nibble << 4) 
-                    | fourth_nibble;
-                break;
-            case 2: // calls subroutine at NNN
-                stack.push_back(pc);
-                pc = (second_nibble << 8) | (third_nibble << 4) 
-                    | fourth_nibble;
-                break;
-            case 3: // skip if VX equals NN
-                if (registers[second_nibble] == 
-                        ((third_nibble) << 4 | fourth_nibble)) {
-                    pc += 2;
-                }
-                break;
-            case 4: // skip if VX does not equal NN
-                if (registers[second_nibble] != 
-                        ((third_nibble) << 4 | fourth_nibble)) {
-                    pc += 2;
-                }
-                break;
-            case 5: // skip if VX == VY
-                if (registers[second_nibble] == 
-                        registers[third_nibble]) {
-                    pc += 2;
-                }
-                break;
-            case 6: // set register VX to NN
-                registers[second_nibble] = 
-                    (third_nibble << 4) | fourth_nibble;
-                break;
-            case 7: // add value NN to register VX
-                registers[second_nibble] += 
-                    (third_nibble << 4) | fourth_nibble;
-                break;
-            case 8: // logical and arithmetic instructions
-                switch (fourth_nibble) {
-                    case 0: // Set VX to value of VY
-                        registers[second_nibble] = 
-                            registers[third_nibble];
-                        break;
-                    case 1: // Binary OR
-                        registers[second_nibble] |= 
-                            registers[third_nibble];
-                        registers[0xF] = 0;
-                        break;
-                    case 2: // Binary AND
-                        registers[second_nibble] &= 
-                            registers[third_nibble];
-                        registers[0xF] = 0;
-                        break;
-                    case 3: // Logical XOR
-                        registers[second_nibble] ^= 
-                            registers[third_nibble];
-                        registers[0xF] = 0;
-                        break;
-                    case 4: // Add VX + VY
-                        {
-                            Byte isThereOverflow;
-                            // check for overflow
-                            if (registers[third_nibble] > 0 
-                                    && registers[second_nibble] > 255 - registers[third_nibble]) {
-                                isThereOverflow = 1; 
-                            } else {
-                                isThereOverflow = 0;
-                            }
-                            registers[second_nibble] += 
-                                registers[third_nibble];
-                            registers[0xF] = isThereOverflow;
-                        }
-                        
-                        break;
-                    case 5: // Subtract VX - VY
-                        {
-                            Byte isThereUnderflow;
-                            if (registers[second_nibble] < registers[third_nibble]) {
-                                isThereUnderflow = 1;
-                            } else {
-                                isThereUnderflow = 0;
-                            }
-                            registers[second_nibble] -= 
-                                registers[third_nibble];
-                            registers[0xF] = !isThereUnderflow;
-                        }
-                        break;
-                    case 6: // Shift right
-                        // Optional or configurable
-                        registers[second_nibble] = registers[third_nibble];
-                        {
-                            Byte shiftedBit =  
-                                registers[second_nibble] & 1;
-                            registers[second_nibble] = 
-                                registers[second_nibble] >> 1;
-                            registers[0xF] = shiftedBit;
-                        }
-                        break;
-                    case 7: // Subtract VY - VX
-                        {
-                            Byte isThereUnderflow;
-                            if (registers[second_nibble] > registers[third_nibble]) {
-                                isThereUnderflow = 1;
-                            } else {
-                                isThereUnderflow = 0;
-                            }
-                            registers[second_nibble] = 
-                                registers[third_nibble] - registers[second_nibble];
-                            registers[0xF] = !isThereUnderflow;
-                        }
-                        break;
-                    case 0xE: // Shift left
-                        // Optional or configurable
-                        registers[second_nibble] = registers[third_nibble];
-                        {
-                            Byte shiftedBit = 
-                                (registers[second_nibble] & (1 << 7)) >> 7;
-                            registers[second_nibble] = 
-                                registers[second_nibble] << 1;
-                            registers[0xF] = shiftedBit;
-                        }
-                        break;
-                }
-                break;
-            case 9: // skip if VX != VY
-                if (registers[second_nibble] != 
-                        registers[third_nibble]) {
-                    pc += 2;
-                }
-                break;
-            case 0xA: // set index register I to NNN
-                i_reg = (second_nibble << 8) 
-                        | (third_nibble << 4) | fourth_nibble;
-                break;
-            case 0xB: // Jump with offset
-                // optional / configurable 
-                // XNN plus value in register VX
-                //pc = registers[second_nibble] + (second_nibble << 8) | (third_nibble << 4) | fourth_nibble;
-                pc = registers[0] + 
-                    ((second_nibble << 8) | (third_nibble << 4) 
-                    | fourth_nibble);
-                break;
-            case 0xC: // CXNN (Random)
-                registers[second_nibble] = 
-                    mt() & (third_nibble << 4 | fourth_nibble);
-                break;
-            case 0xD: // display (DXYN)*/
-                {
-                    // get x and y coordinates
-                    int x = registers[second_nibble] & (screen_width - 1);
-                    int y = registers[third_nibble] & (screen_height - 1);
-                    
-                    // set flag register to 0
-                    registers[0xF] = 0;
-
-                    // iterate over height N
-                    for (int i = 0; i < fourth_nibble; i++) {
-                        // if screen bottom is reached
-                        if (y + i >= screen_height) {
-                            break;
-                        }
-                        // iterate over sprite row
-                        Byte spriteRow = ram[i_reg + i];
-                        for (int j = 7; j >= 0; j--) {
-                            // if screen edge is reached
-                            if (x + 7 - j >= screen_width) {
-                                continue;
-                            }
-
-                            bool currentBit = spriteRow & (1 << j);
-                            // coordinates for pixels vector
-                            int xP = x + 7 - j;
-                            int yP = y + i;
-
-                            if (currentBit) {
-                                if (pixels[xP][yP]) {
-                                    registers[0xF] = 1;
-                                }
-                                pixels[xP][yP] = !pixels[xP][yP];
-                            }
-                        }
-                    }
-                }
-                break;
-            case 0xE:
-                if (third_nibble == 0x9 && fourth_nibble == 0xE) {
-                    // EX9E skip if key is pressed
-                    if (keys[registers[second_nibble]]) {
-                        pc += 2;
-                    }
-                } else if (third_nibble == 0xA && fourth_nibble == 0x1) {
-                    // EXA1 skip if key is not pressed
-                    if (!keys[registers[second_nibble]]) {
-                        pc += 2;
-                    }
-                }
-                break;
-            case 0xF:
-                if (third_nibble == 0 && fourth_nibble == 7) {
-                    // Sets VX to delay timer value
-                    registers[second_nibble] = dTimer;
-                } else if (third_nibble == 1 && fourth_nibble == 5) {
-                    // Sets delay timer to VX value
-                    dTimer = registers[second_nibble];
-                } else if (third_nibble == 1 && fourth_nibble == 8) {
-                    // set sound timer to VX value
-                    sTimer = registers[second_nibble];
-                } else if (third_nibble == 1 && fourth_nibble == 0xE) {
-                    // add VX value to I register
-                    i_reg += registers[second_nibble];
-                    // Amiga (spacefight 2091!) behavior
-                    //if (i_reg > 0x0FFF) {
-                    //    registers[0xF] = 1;
-                    //}
-                } else if (third_nibble == 0 && fourth_nibble == 0xA) {
-                    // Get key
-                    pc -= 2;
-                    if (lastKey == -1) {
-                        for (int i = 0; i < keys.size(); i++) {
-                            if (keys[i]) {
-                                registers[second_nibble] = i;
-                                lastKey = i;
-                                break;
-                            }
-                        }
-                    } else { // wait until released
-                        if (!keys[lastKey]) {
-                            pc += 2;
-                            lastKey = -1;
-                        }
-                    }
-                } else if (third_nibble == 2 && fourth_nibble == 9) {
-                    // font character
-                    int offset = 5 * (registers[second_nibble] & 0xF);
-                    i_reg = 0x50 + offset;
-                } else if (third_nibble == 3 && fourth_nibble == 3) {
-                    // binary-coded decimal conversion
-                    ram[i_reg] = registers[second_nibble] / 100;
-                    ram[i_reg+1] = (registers[second_nibble] / 10) % 10;
-                    ram[i_reg+2] = registers[second_nibble] % 10;
-                } else if (third_nibble == 5 && fourth_nibble == 5) {
-                    // store registers into memory
-                    for (int i = 0; i <= second_nibble; i++) {
-                        ram[i_reg + i] = registers[i];
-                    }
-                    // configurable
-                    i_reg = i_reg + second_nibble + 1;
-                } else if (third_nibble == 6 && fourth_nibble == 5) {
-                    // load memory into registers
-                    for (int i = 0; i <= second_nibble; i++) {
-                        registers[i] = ram[i_reg + i];
-                    }
-                    // configurable
-                    i_reg = i_reg + second_nibble + 1;
-                }
-                break;
-            default: // undetermined
-                /*
-                std::cout << std::hex << 
-                    (int)first_nibble <<
-                    (int)second_nibble <<
-                    (int)third_nibble <<
-                    (int)fourth_nibble << "\n";
-                */
-                break;
+            // update screen
+#if CHIP8_PROFILER
+            Uint64 presentStart = SDL_GetTicksNS();
+            screen.setOverlay(frame.overlay);
+#endif
+            screen.present(frame.pixels);
+#if CHIP8_PROFILER
+            emulator.presentTime(SDL_GetTicksNS() - presentStart);
+#endif
+
+            bool rateChanged = frame.achievedRate != shownRate;
+            if (frame.fastForward != wasFastForward 
+                    || (!frame.fastForward && rateChanged)) {
+                char title[64];
+                SDL_snprintf(title, sizeof(title), "Chip-8 (%.1f / %d fps)",
+                    frame.achievedRate, EmulatorThread::frame_rate);
+                SDL_SetWindowTitle(window, 
+                    frame.fastForward ? "Chip-8 (fast-forward)" : title);
+                wasFastForward = frame.fastForward;
+                shownRate = frame.achievedRate;
             }
-            instr_counter++;
         }
+        emulator.stop();
+        emulator.writeSave();
+        console.close();
+
+        SDL_Log("Frame pacing: %llu late frames\n", 
+            (unsigned long long)emulator.lateFrames());
+        if (options.rewindSeconds > 0) {
+            const Rewind& rewind = emulator.history();
+            SDL_Log("Rewind: %d frames in %zu bytes (%.1f KB per minute)\n",
+                rewind.frames(), rewind.bytesUsed(), 
+                rewind.bytesPerMinute() / 1024);
+        }
+#if CHIP8_PROFILER
+        if (chip8.profiler != NULL) {
+            profiler.report(stderr);
+        }
+#endif
+    }
+
+    if (recorder.close() != 0) {
+        closeSDL(window, renderer, audio);
+        return EXIT_FAILURE;
     }
 
     // Free resources and close SDL
-    closeSDL(window, renderer, wav_data);
+    closeSDL(window, renderer, audio);
 
     return 0;
 }
\ No newline at end of file
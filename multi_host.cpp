@@ -0,0 +1,207 @@
+#include "multi_host.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "chip8_ops.h"
+#include "font.h"
+
+// instructions of the original CHIP-8, the only ones instances run, plus
+// F000 NNNN so XO-CHIP skips over its second word land where they should
+#define MULTI_HOST_OPCODES(X) \
+    X(00E0) X(00EE) X(0NNN) \
+    X(1NNN) X(2NNN) X(3XNN) X(4XNN) X(5XY0) X(6XNN) X(7XNN) \
+    X(8XY0) X(8XY1) X(8XY2) X(8XY3) X(8XY4) X(8XY5) X(8XY6) X(8XY7) \
+    X(8XYE) \
+    X(9XY0) X(ANNN) X(BNNN) X(CXNN) X(DXYN) X(EX9E) X(EXA1) \
+    X(FX07) X(FX0A) X(FX15) X(FX18) X(FX1E) X(FX29) X(FX33) X(FX55) \
+    X(FX65) X(F000)
+
+const int MultiHost::bytes_per_instance = ram_size
+    + display_rows * sizeof(uint64_t) + 16 * sizeof(Byte)
+    + 16 * sizeof(TwoByte) + 2 * sizeof(TwoByte) + 3 * sizeof(Byte)
+    + sizeof(uint16_t) + sizeof(int8_t) + sizeof(uint32_t)
+    + sizeof(uint8_t);
+
+// One instance's slice of the arrays, with the members the instruction
+// handlers use on Chip8.
+struct MultiHost::Instance {
+    // 4 kB of RAM, addresses wrap
+    struct Memory {
+        Byte* bytes;
+        Byte& operator[](int address) const {
+            return bytes[address & (ram_size - 1)];
+        }
+    };
+
+    // single plane, one word per row
+    struct Display {
+        static constexpr int width = Chip8::screen_width;
+        static constexpr int height = Chip8::screen_height;
+        uint64_t* rows;
+
+        void clear() { std::memset(rows, 0, height * sizeof(uint64_t)); }
+        bool selected(int plane) const { return plane == 0; }
+        bool drawRow(int, int x, int y, uint64_t sprite) {
+            // columns past the right edge shift out of the word
+            uint64_t mask = sprite >> x;
+            bool collision = (rows[y] & mask) != 0;
+            rows[y] ^= mask;
+            return collision;
+        }
+    };
+
+    struct Keys {
+        uint16_t mask;
+        bool operator[](int key) const { return (mask >> key) & 1; }
+        static constexpr int size() { return 16; }
+    };
+
+    // xorshift32, 4 bytes of state instead of a Mersenne Twister's 2.5 kB
+    struct Random {
+        uint32_t& state;
+        uint32_t operator()() {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            return state;
+        }
+    };
+
+    Instance(MultiHost& host, int i)
+        : ram{ &host.ram[(size_t)i * ram_size] },
+          pc(host.pcs[i]), i_reg(host.indexes[i]),
+          stack(&host.stacks[i * 16]), sp(host.sps[i]),
+          registers(&host.registers[i * 16]),
+          dTimer(host.dTimers[i]), sTimer(host.sTimers[i]),
+          pixels{ &host.displays[(size_t)i * display_rows] },
+          keys{ host.keys[i] }, lastKey(host.lastKeys[i]),
+          mt{ host.random[i] } {}
+
+    Memory ram;
+    TwoByte& pc;
+    TwoByte& i_reg;
+    TwoByte* stack;
+    Byte& sp;
+    Byte* registers;
+    Byte& dTimer;
+    Byte& sTimer;
+    Display pixels;
+    Keys keys;
+    int8_t& lastKey;
+    Random mt;
+};
+
+MultiHost::MultiHost(int instances, QuirkProfile profile, int threads)
+    : instructionsPerFrame(Chip8::instructions_per_frame),
+      count(instances), profile(profile), pool(threads),
+      ram((size_t)instances * ram_size),
+      displays((size_t)instances * display_rows),
+      registers(instances * 16), stacks(instances * 16),
+      pcs(instances), indexes(instances), sps(instances),
+      dTimers(instances), sTimers(instances), keys(instances),
+      lastKeys(instances), random(instances), loaded(instances) {
+}
+
+int MultiHost::load(int instance, const Byte* program, int size,
+        uint32_t seed) {
+    if (size < 0 || size > ram_size - 0x200) {
+        std::cerr << "Program is too large.\n";
+        return 1;
+    }
+    Byte* memory = &ram[(size_t)instance * ram_size];
+    std::memset(memory, 0, ram_size);
+    std::memcpy(memory + Chip8::font_address, font_data, sizeof(font_data));
+    std::copy(program, program + size, memory + 0x200);
+
+    std::fill_n(&displays[(size_t)instance * display_rows], display_rows, 0);
+    std::fill_n(&registers[instance * 16], 16, 0);
+    std::fill_n(&stacks[instance * 16], 16, 0);
+    pcs[instance] = 0x200;
+    indexes[instance] = 0;
+    sps[instance] = 0;
+    dTimers[instance] = 0;
+    sTimers[instance] = 0;
+    keys[instance] = 0;
+    lastKeys[instance] = -1;
+    // xorshift never leaves 0
+    random[instance] = seed != 0 ? seed : 1;
+    loaded[instance] = 1;
+    return 0;
+}
+
+void MultiHost::unload(int instance) {
+    loaded[instance] = 0;
+}
+
+void MultiHost::setKeyMask(int instance, uint16_t mask) {
+    keys[instance] = mask;
+}
+
+void MultiHost::runFrame() {
+    for (int begin = 0; begin < count; begin += batch_size) {
+        int end = std::min(begin + batch_size, count);
+        pool.submit([this, begin, end] {
+            switch (profile) {
+#define CHIP8_PROFILE_CASE(name, flag) \
+            case QuirkProfile::name: \
+                runBatch<QuirkProfile::name>(begin, end); \
+                break;
+                CHIP8_QUIRK_PROFILES(CHIP8_PROFILE_CASE)
+#undef CHIP8_PROFILE_CASE
+            }
+        });
+    }
+    pool.wait();
+}
+
+template <QuirkProfile P>
+void MultiHost::runBatch(int begin, int end) {
+    // one instruction per machine at a time, so the whole batch's state
+    // (about 280 kB) stays in cache for the frame
+    const OpClass* classes = opcodeClasses<P>();
+    for (int n = 0; n < instructionsPerFrame; n++) {
+        for (int i = begin; i < end; i++) {
+            if (loaded[i]) {
+                Instance machine(*this, i);
+                step<P>(machine, classes);
+            }
+        }
+    }
+    for (int i = begin; i < end; i++) {
+        if (dTimers[i] > 0) dTimers[i]--;
+        if (sTimers[i] > 0) sTimers[i]--;
+    }
+}
+
+template <QuirkProfile P>
+void MultiHost::step(Instance& machine, const OpClass* classes) {
+    TwoByte opcode = (machine.ram[machine.pc] << 8)
+        | machine.ram[machine.pc + 1];
+    machine.pc += 2;
+    switch (classes[opcode]) {
+#define CHIP8_CASE(name) \
+    case OP_##name: op##name<P>(machine, opcode); break;
+        MULTI_HOST_OPCODES(CHIP8_CASE)
+#undef CHIP8_CASE
+    default: // other SUPER-CHIP and XO-CHIP instructions, not supported
+        break;
+    }
+}
+
+uint64_t MultiHost::displayHash(int instance) const {
+    // rows hashed as Chip8's 128-bit rows with the right half blank
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    const uint64_t* rows = display(instance);
+    for (int y = 0; y < display_rows; y++) {
+        for (int w = 0; w < 2; w++) {
+            uint64_t word = w == 0 ? rows[y] : 0;
+            for (int b = 0; b < 8; b++) {
+                hash ^= (word >> (8 * b)) & 0xFF;
+                hash *= 0x100000001b3ULL;
+            }
+        }
+    }
+    return hash;
+}
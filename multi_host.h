@@ -0,0 +1,92 @@
+#ifndef MULTI_HOST_H
+#define MULTI_HOST_H
+
+#include <cstdint>
+#include <vector>
+
+#include "chip8.h"
+#include "thread_pool.h"
+
+// Many CHIP-8 machines in one process, e.g. one per network session.
+// State is kept as structure of arrays: each field of every instance sits
+// in one contiguous array (all RAM, then all displays, all registers...),
+// and instances only have what the CHIP-8 instruction set needs, about
+// 4.3 kB each. Every frame the instances are split into batches stepped
+// in lockstep, one instruction for each machine in the batch at a time,
+// with the batches spread across a thread pool.
+//
+// Instances run the shared instruction handlers with the host's quirk
+// profile. Their 4 kB of RAM and the 64x32 display leave out the
+// SUPER-CHIP and XO-CHIP extensions, whose instructions are ignored
+// (apart from F000 NNNN, which XO-CHIP skips step over).
+class MultiHost {
+public:
+    static const int ram_size = 4096;
+    static const int display_rows = Chip8::screen_height;
+    // instances stepped together by one task
+    static const int batch_size = 64;
+    // bytes of state per instance
+    static const int bytes_per_instance;
+
+    // threads <= 0 uses one per hardware thread
+    MultiHost(int instances, QuirkProfile profile = QuirkProfile::CosmacVip,
+        int threads = 0);
+
+    int size() const { return count; }
+
+    // reset an instance and load a program at 0x200, 1 if too large;
+    // instances run from their first load on
+    int load(int instance, const Byte* program, int size,
+        uint32_t seed = 1);
+    // stop running an instance, its slot can be loaded again
+    void unload(int instance);
+
+    // key state as a bitmask, bit n set while key n is held
+    void setKeyMask(int instance, uint16_t mask);
+
+    // run instructionsPerFrame instructions on every loaded instance,
+    // then update their timers
+    void runFrame();
+
+    // 64x32 display, one word per row with the leftmost pixel in the top
+    // bit; valid until the next runFrame
+    const uint64_t* display(int instance) const {
+        return &displays[(size_t)instance * display_rows];
+    }
+    // sound timer running
+    bool buzzing(int instance) const { return sTimers[instance] > 0; }
+    // FNV-1a hash of the display, matches Chip8::framebufferHash
+    uint64_t displayHash(int instance) const;
+
+    // CPU speed, instructions per 60Hz timer tick for every instance
+    int instructionsPerFrame;
+
+private:
+    struct Instance;
+
+    template <QuirkProfile P> void runBatch(int begin, int end);
+    // classes is the profile's decode table, opcodeClasses<P>()
+    template <QuirkProfile P>
+    void step(Instance& machine, const OpClass* classes);
+
+    int count;
+    QuirkProfile profile;
+    ThreadPool pool;
+
+    // one entry, or block of entries, per instance
+    std::vector<Byte> ram;
+    std::vector<uint64_t> displays;
+    std::vector<Byte> registers;
+    std::vector<TwoByte> stacks;
+    std::vector<TwoByte> pcs;
+    std::vector<TwoByte> indexes;
+    std::vector<Byte> sps;
+    std::vector<Byte> dTimers;
+    std::vector<Byte> sTimers;
+    std::vector<uint16_t> keys;
+    std::vector<int8_t> lastKeys;
+    std::vector<uint32_t> random;
+    std::vector<uint8_t> loaded;
+};
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef OPCODES_H
+#define OPCODES_H
+
+#include <cstdint>
+
+#include "quirks.h"
+
+// Every instruction the interpreter distinguishes, named after its opcode
+// pattern. Used to generate the decode tables, handler tables and
+// computed-goto labels so they can never get out of sync. Includes the
+// SUPER-CHIP (00CN, 00FB-00FF, FX30, FX75, FX85) and XO-CHIP (00DN, 5XY2,
+// 5XY3, F000, FN01, F002, FX3A) extensions, decoded only for profiles that
+// have them.
+#define CHIP8_OPCODES(X) \
+    X(INVALID) \
+    X(00E0) X(00EE) X(0NNN) \
+    X(00CN) X(00DN) X(00FB) X(00FC) X(00FD) X(00FE) X(00FF) \
+    X(1NNN) X(2NNN) X(3XNN) X(4XNN) X(5XY0) X(5XY2) X(5XY3) X(6XNN) \
+    X(7XNN) \
+    X(8XY0) X(8XY1) X(8XY2) X(8XY3) X(8XY4) X(8XY5) X(8XY6) X(8XY7) \
+    X(8XYE) \
+    X(9XY0) X(ANNN) X(BNNN) X(CXNN) X(DXYN) X(EX9E) X(EXA1) \
+    X(F000) X(FN01) X(F002) \
+    X(FX07) X(FX0A) X(FX15) X(FX18) X(FX1E) X(FX29) X(FX30) X(FX33) \
+    X(FX3A) X(FX55) X(FX65) X(FX75) X(FX85)
+
+enum OpClass : uint8_t {
+#define CHIP8_OPCLASS_ENUM(name) OP_##name,
+    CHIP8_OPCODES(CHIP8_OPCLASS_ENUM)
+#undef CHIP8_OPCLASS_ENUM
+    OP_COUNT
+};
+
+// opcode pattern name, e.g. "DXYN"
+const char* opClassName(OpClass opClass);
+
+// decode a 16-bit opcode into its instruction class, with the extensions
+// of a quirk profile
+inline OpClass decodeOpcode(uint16_t opcode, Extensions extensions) {
+    uint8_t first_nibble = opcode >> 12;
+    uint8_t second_nibble = (opcode >> 8) & 0xF;
+    uint8_t low_byte = opcode & 0xFF;
+    bool super = extensions != Extensions::None;
+    bool xo = extensions == Extensions::XoChip;
+
+    switch (first_nibble) {
+    case 0:
+        if (second_nibble != 0) return OP_0NNN;
+        if (low_byte == 0xE0) return OP_00E0;
+        if (low_byte == 0xEE) return OP_00EE;
+        if (super) {
+            switch (low_byte) {
+            case 0xFB: return OP_00FB;
+            case 0xFC: return OP_00FC;
+            case 0xFD: return OP_00FD;
+            case 0xFE: return OP_00FE;
+            case 0xFF: return OP_00FF;
+            }
+            if ((low_byte & 0xF0) == 0xC0) return OP_00CN;
+        }
+        if (xo && (low_byte & 0xF0) == 0xD0) return OP_00DN;
+        return OP_0NNN;
+    case 1: return OP_1NNN;
+    case 2: return OP_2NNN;
+    case 3: return OP_3XNN;
+    case 4: return OP_4XNN;
+    case 5:
+        if (xo && (opcode & 0xF) == 2) return OP_5XY2;
+        if (xo && (opcode & 0xF) == 3) return OP_5XY3;
+        return OP_5XY0;
+    case 6: return OP_6XNN;
+    case 7: return OP_7XNN;
+    case 8:
+        switch (opcode & 0xF) {
+        case 0: return OP_8XY0;
+        case 1: return OP_8XY1;
+        case 2: return OP_8XY2;
+        case 3: return OP_8XY3;
+        case 4: return OP_8XY4;
+        case 5: return OP_8XY5;
+        case 6: return OP_8XY6;
+        case 7: return OP_8XY7;
+        case 0xE: return OP_8XYE;
+        default: return OP_INVALID;
+        }
+    case 9: return OP_9XY0;
+    case 0xA: return OP_ANNN;
+    case 0xB: return OP_BNNN;
+    case 0xC: return OP_CXNN;
+    case 0xD: return OP_DXYN;
+    case 0xE:
+        if (low_byte == 0x9E) return OP_EX9E;
+        if (low_byte == 0xA1) return OP_EXA1;
+        return OP_INVALID;
+    default: // 0xF
+        if (xo && opcode == 0xF000) return OP_F000;
+        if (xo && opcode == 0xF002) return OP_F002;
+        switch (low_byte) {
+        case 0x01: return xo ? OP_FN01 : OP_INVALID;
+        case 0x07: return OP_FX07;
+        case 0x0A: return OP_FX0A;
+        case 0x15: return OP_FX15;
+        case 0x18: return OP_FX18;
+        case 0x1E: return OP_FX1E;
+        case 0x29: return OP_FX29;
+        case 0x30: return super ? OP_FX30 : OP_INVALID;
+        case 0x33: return OP_FX33;
+        case 0x3A: return xo ? OP_FX3A : OP_INVALID;
+        case 0x55: return OP_FX55;
+        case 0x65: return OP_FX65;
+        case 0x75: return super ? OP_FX75 : OP_INVALID;
+        case 0x85: return super ? OP_FX85 : OP_INVALID;
+        default: return OP_INVALID;
+        }
+    }
+}
+
+#endif
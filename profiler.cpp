@@ -0,0 +1,104 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+void Profiler::reset() {
+    std::memset(opCounts, 0, sizeof(opCounts));
+    std::memset(addressHits, 0, sizeof(addressHits));
+    frames = 0;
+    quotaFrames = 0;
+    presentNs = 0;
+    audioNs = 0;
+    frameIdle = false;
+}
+
+void Profiler::endFrame() {
+    frames++;
+    if (!frameIdle) {
+        quotaFrames++;
+    }
+    frameIdle = false;
+}
+
+uint64_t Profiler::instructions() const {
+    uint64_t total = 0;
+    for (uint64_t count : opCounts) {
+        total += count;
+    }
+    return total;
+}
+
+namespace {
+
+// indices of the n largest counts, largest first, zero counts left out
+template <size_t N>
+std::vector<int> top(const uint64_t (&counts)[N], int n) {
+    std::vector<int> order;
+    for (size_t i = 0; i < N; i++) {
+        if (counts[i] > 0) order.push_back(i);
+    }
+    n = std::min<int>(n, order.size());
+    std::partial_sort(order.begin(), order.begin() + n, order.end(),
+        [&counts](int a, int b) { return counts[a] > counts[b]; });
+    order.resize(n);
+    return order;
+}
+
+double percent(uint64_t part, uint64_t total) {
+    return total > 0 ? 100.0 * part / total : 0.0;
+}
+
+double perFrameUs(uint64_t ns, uint64_t frames) {
+    return frames > 0 ? ns / 1000.0 / frames : 0.0;
+}
+
+}
+
+std::string Profiler::overlay() const {
+    uint64_t total = instructions();
+    char line[96];
+    std::string text;
+    for (int op : top(opCounts, 4)) {
+        std::snprintf(line, sizeof(line), "%-4s %5.1f%%\n",
+            opClassName((OpClass)op), percent(opCounts[op], total));
+        text += line;
+    }
+    std::vector<int> hot = top(addressHits, 1);
+    if (!hot.empty()) {
+        std::snprintf(line, sizeof(line), "hot  %03X %4.1f%%\n", hot[0],
+            percent(addressHits[hot[0]], total));
+        text += line;
+    }
+    std::snprintf(line, sizeof(line),
+        "draw %.0fus audio %.0fus\nquota %.0f%% of %llu frames\n",
+        perFrameUs(presentNs, frames), perFrameUs(audioNs, frames),
+        percent(quotaFrames, frames), (unsigned long long)frames);
+    text += line;
+    return text;
+}
+
+void Profiler::report(std::FILE* out) const {
+    uint64_t total = instructions();
+    std::fprintf(out, "profile: %llu instructions in %llu frames\n",
+        (unsigned long long)total, (unsigned long long)frames);
+    std::fprintf(out, "frames using the whole instruction quota: %llu "
+        "(%.1f%%)\n", (unsigned long long)quotaFrames,
+        percent(quotaFrames, frames));
+    std::fprintf(out, "per frame: present %.1f us, audio %.1f us\n",
+        perFrameUs(presentNs, frames), perFrameUs(audioNs, frames));
+
+    std::fprintf(out, "opcode classes:\n");
+    for (int op : top(opCounts, OP_COUNT)) {
+        std::fprintf(out, "  %-7s %12llu %5.1f%%\n",
+            opClassName((OpClass)op), (unsigned long long)opCounts[op],
+            percent(opCounts[op], total));
+    }
+    std::fprintf(out, "hottest addresses:\n");
+    for (int address : top(addressHits, 16)) {
+        std::fprintf(out, "  %03X %12llu %5.1f%%\n", address,
+            (unsigned long long)addressHits[address],
+            percent(addressHits[address], total));
+    }
+}
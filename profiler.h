@@ -0,0 +1,56 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "opcodes.h"
+
+// Counts what a program spends its cycles on. Attached to a Chip8 core
+// built with CHIP8_PROFILER, which then runs an instrumented loop; without
+// that define none of the hooks are compiled in, and with it a detached
+// profiler costs one pointer test per run() call.
+class Profiler {
+public:
+    // address histogram over the classic 4 kB; XO-CHIP addresses fold in
+    static const int histogram_size = 4096;
+
+    Profiler() { reset(); }
+
+    void reset();
+
+    // one executed instruction, from the instrumented loop
+    void instruction(uint16_t address, OpClass opClass) {
+        opCounts[opClass]++;
+        addressHits[address & (histogram_size - 1)]++;
+    }
+    // the program stopped to wait (key wait, jump to self, exit)
+    void idle() { frameIdle = true; }
+    // end of a 60Hz frame; a frame that never waited used its full quota
+    void endFrame();
+
+    // front end time spent per frame, in nanoseconds
+    void presentTime(uint64_t ns) { presentNs += ns; }
+    void audioTime(uint64_t ns) { audioNs += ns; }
+
+    // a few lines for the on-screen overlay
+    std::string overlay() const;
+    // full report: opcode classes, hottest addresses, timings
+    void report(std::FILE* out) const;
+
+    uint64_t opCounts[OP_COUNT];
+    uint64_t addressHits[histogram_size];
+    uint64_t frames;
+    // frames that ran every instruction of the quota without waiting
+    uint64_t quotaFrames;
+    uint64_t presentNs;
+    uint64_t audioNs;
+
+private:
+    uint64_t instructions() const;
+
+    bool frameIdle;
+};
+
+#endif
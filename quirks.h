@@ -0,0 +1,97 @@
+#ifndef QUIRKS_H
+#define QUIRKS_H
+
+#include <cstdint>
+
+// Behaviour that differs between Chip-8 implementations. Profiles are
+// compile-time constants: every dispatch engine is instantiated once per
+// profile, so the choice costs nothing per instruction.
+
+// how far FX55 / FX65 move I past the registers they copy
+enum class IndexIncrement : uint8_t {
+    // I += X + 1 (COSMAC VIP)
+    XPlusOne,
+    // I += X (CHIP-48)
+    X,
+    // I unchanged (SUPER-CHIP)
+    None
+};
+
+// instruction set extensions decoded on top of CHIP-8; opcodes outside
+// the set keep their CHIP-8 meaning (0NNN, 5XY0 skip) or are ignored
+enum class Extensions : uint8_t {
+    None,
+    // 00CN, 00FB-00FF, 16x16 DXY0, FX30, FX75 / FX85
+    SuperChip,
+    // SUPER-CHIP plus 00DN, 5XY2 / 5XY3, F000 NNNN, FN01, F002, FX3A
+    XoChip
+};
+
+struct Quirks {
+    // 8XY6 / 8XYE copy VY into VX before shifting
+    bool shiftUsesVY;
+    // BNNN jumps to XNN + VX instead of NNN + V0
+    bool jumpUsesVX;
+    IndexIncrement indexIncrement;
+    // 8XY1 / 8XY2 / 8XY3 clear VF
+    bool logicResetsVF;
+    // FX1E sets VF when I goes past 0xFFF (Amiga interpreter)
+    bool indexOverflowSetsVF;
+    Extensions extensions;
+};
+
+// name, command line name
+#define CHIP8_QUIRK_PROFILES(X) \
+    X(CosmacVip, "vip") \
+    X(Chip48, "chip48") \
+    X(SuperChip, "schip") \
+    X(XoChip, "xochip") \
+    X(Amiga, "amiga")
+
+enum class QuirkProfile : uint8_t {
+#define CHIP8_PROFILE_ENUM(name, flag) name,
+    CHIP8_QUIRK_PROFILES(CHIP8_PROFILE_ENUM)
+#undef CHIP8_PROFILE_ENUM
+};
+
+const int quirk_profile_count = 0
+#define CHIP8_PROFILE_COUNT(name, flag) + 1
+    CHIP8_QUIRK_PROFILES(CHIP8_PROFILE_COUNT)
+#undef CHIP8_PROFILE_COUNT
+    ;
+
+constexpr Quirks quirksOf(QuirkProfile profile) {
+    switch (profile) {
+    case QuirkProfile::Chip48:
+        return { false, true, IndexIncrement::X, false, false,
+            Extensions::None };
+    case QuirkProfile::SuperChip:
+        return { false, true, IndexIncrement::None, false, false,
+            Extensions::SuperChip };
+    case QuirkProfile::XoChip:
+        return { true, false, IndexIncrement::XPlusOne, false, false,
+            Extensions::XoChip };
+    case QuirkProfile::Amiga:
+        // SUPER-CHIP games written against the Amiga interpreter
+        // (Spacefight 2091!)
+        return { false, true, IndexIncrement::None, false, true,
+            Extensions::SuperChip };
+    default: // CosmacVip
+        return { true, false, IndexIncrement::XPlusOne, true, false,
+            Extensions::None };
+    }
+}
+
+// bytes of RAM a profile addresses, wrapping at the end: 4 kB, or 64 kB
+// for XO-CHIP
+constexpr int memorySizeOf(QuirkProfile profile) {
+    return quirksOf(profile).extensions == Extensions::XoChip
+        ? 0x10000 : 0x1000;
+}
+
+// command line name, e.g. "schip"
+const char* quirkProfileName(QuirkProfile profile);
+// look up a profile by command line name, false if unknown
+bool parseQuirkProfile(const char* name, QuirkProfile& profile);
+
+#endif
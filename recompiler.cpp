@@ -0,0 +1,368 @@
+#include "chip8.h"
+#include "chip8_ops.h"
+
+int BlockCache::insert(uint16_t start, uint16_t end, uint16_t exit,
+        int instructions, const std::vector<BlockOp>& blockOps) {
+    // address tables are only allocated once the Blocks engine runs
+    if (index.empty()) {
+        index.assign(ram_size, -1);
+        codeRefs.assign(ram_size, 0);
+        codePages.assign((ram_size >> page_bits) + 1, 0);
+    }
+    int i;
+    if (!freeSlots.empty()) {
+        i = freeSlots.back();
+        freeSlots.pop_back();
+    } else {
+        i = blocks.size();
+        blocks.emplace_back();
+    }
+    Block& block = blocks[i];
+    block.start = start;
+    block.end = end;
+    block.exit = exit;
+    block.instructions = instructions;
+    block.opCount = blockOps.size();
+    block.live = true;
+    block.next[0] = -1;
+    block.next[1] = -1;
+    std::copy(blockOps.begin(), blockOps.end(), block.ops);
+    block.ops[block.opCount].opClass = BlockOp::stop;
+    for (int n = 0; n < block.opCount; n++) {
+        const BlockOp& op = block.ops[n];
+        std::fill_n(block.opOf + op.before, op.length, n);
+    }
+    live++;
+
+    for (int a = start; a < end; a++) {
+        codeRefs[a]++;
+    }
+    for (int p = start >> page_bits; p <= (end - 1) >> page_bits; p++) {
+        codePages[p]++;
+    }
+    index[start] = i;
+    return i;
+}
+
+void BlockCache::remove(int i) {
+    Block& block = blocks[i];
+    block.live = false;
+    index[block.start] = -1;
+    for (int a = block.start; a < block.end; a++) {
+        codeRefs[a]--;
+    }
+    for (int p = block.start >> page_bits; p <= (block.end - 1) >> page_bits;
+            p++) {
+        codePages[p]--;
+    }
+    freeSlots.push_back(i);
+    live--;
+}
+
+void BlockCache::invalidate(int address, int length) {
+    if (codeRefs.empty()) {
+        return;
+    }
+    // cheap reject, most writes never touch code
+    int last = std::min(address + length, (int)ram_size);
+    bool hit = false;
+    for (int a = address; a < last; a++) {
+        if (codeRefs[a]) {
+            hit = true;
+            break;
+        }
+    }
+    if (!hit) {
+        return;
+    }
+
+    // a block covering the write starts at most one block length before
+    // it, so only those start addresses are looked up
+    int first = std::max(0, address - 2 * Block::max_instructions + 1);
+    for (int a = first; a < last; a++) {
+        int i = index[a];
+        if (i >= 0 && blocks[i].end > address) {
+            remove(i);
+        }
+    }
+}
+
+void BlockCache::clear() {
+    blocks.clear();
+    freeSlots.clear();
+    live = 0;
+    std::fill(index.begin(), index.end(), -1);
+    std::fill(codeRefs.begin(), codeRefs.end(), 0);
+    std::fill(codePages.begin(), codePages.end(), 0);
+}
+
+// instructions that change or read pc end a block
+static bool endsBlock(OpClass opClass) {
+    switch (opClass) {
+    case OP_00EE: case OP_1NNN: case OP_2NNN: case OP_BNNN:
+    case OP_3XNN: case OP_4XNN: case OP_5XY0: case OP_9XY0:
+    case OP_EX9E: case OP_EXA1: case OP_FX0A: case OP_00FD:
+    // reads its operand from the next word
+    case OP_F000:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// instructions that store to RAM at I
+static constexpr bool writesMemory(OpClass opClass) {
+    return opClass == OP_FX33 || opClass == OP_FX55 || opClass == OP_5XY2;
+}
+
+// instructions that set I from anything but their own operand
+static bool changesIndex(OpClass opClass) {
+    switch (opClass) {
+    case OP_F000: case OP_FX1E: case OP_FX29: case OP_FX30:
+    case OP_FX55: case OP_FX65:
+        return true;
+    default:
+        return false;
+    }
+}
+
+int Chip8::compileBlock(TwoByte start) {
+    std::vector<BlockOp>& out = blockScratch;
+    out.clear();
+    Extensions extensions = quirksOf(profile).extensions;
+
+    // blocks stop short of the last word so they never wrap around RAM,
+    // an instruction there is interpreted
+    int address = start;
+    int end = start;
+    int instructions = 0;
+    // loop jumps folded into the next op, and the first one's address
+    int jumps = 0;
+    int jumpAddress = 0;
+    // I as set by ANNN in the block, -1 if unknown; loops are only
+    // unrolled while no write so far can land on the block, since one
+    // that does retranslates it
+    int index = -1;
+    bool selfWrite = false;
+    while (instructions < Block::max_instructions
+            && address + 2 < memorySize()) {
+        TwoByte opcode = (ram[address] << 8) | ram[address + 1];
+        OpClass opClass = decodeOpcode(opcode, extensions);
+        instructions++;
+        end = std::max(end, address + 2);
+
+        // a jump back into the block unrolls the loop, as long as an
+        // instruction after it still fits
+        int target = addrNNN(opcode);
+        if (opClass == OP_1NNN && target >= start && target < address
+                && instructions < Block::max_instructions && !selfWrite) {
+            if (jumps++ == 0) {
+                jumpAddress = address;
+            }
+            address = target;
+            continue;
+        }
+
+        // fold 6XNN / 7XNN chains on the same register into one op: a
+        // 6XNN restarts the constant, a 7XNN adds to it
+        bool constant = opClass == OP_6XNN || opClass == OP_7XNN;
+        if (constant && jumps == 0 && !out.empty()
+                && (out.back().opClass == OP_6XNN
+                    || out.back().opClass == OP_7XNN)
+                && nibbleX(out.back().opcode) == nibbleX(opcode)) {
+            BlockOp& prev = out.back();
+            if (opClass == OP_7XNN) {
+                Byte sum = byteNN(prev.opcode) + byteNN(opcode);
+                prev.opcode = (prev.opcode & 0xFF00) | sum;
+            } else {
+                prev.opClass = OP_6XNN;
+                prev.opcode = opcode;
+            }
+            prev.length++;
+        } else {
+            out.push_back({ opClass, (uint8_t)(jumps + 1),
+                (uint8_t)(instructions - jumps - 1), opcode,
+                (uint16_t)(jumps > 0 ? jumpAddress : address) });
+            jumps = 0;
+        }
+        address += 2;
+        if (endsBlock(opClass)) {
+            break;
+        }
+
+        // writes are at most 16 bytes, a block at most 64
+        if (writesMemory(opClass)) {
+            selfWrite = selfWrite || index < 0
+                || (index < start + 2 * Block::max_instructions
+                    && index + 16 > start)
+                || index + 16 > memorySize();
+        }
+        if (opClass == OP_ANNN) {
+            index = addrNNN(opcode);
+        } else if (changesIndex(opClass)) {
+            index = -1;
+        }
+    }
+    return blocks.insert(start, end, address, instructions, out);
+}
+
+// a write by FX33 / FX55 / 5XY2 may land on translated code
+void Chip8::checkCodeWrite(OpClass opClass, TwoByte opcode, TwoByte address) {
+    int length;
+    if (opClass == OP_FX33) {
+        length = 3;
+    } else if (opClass == OP_FX55) {
+        length = nibbleX(opcode) + 1;
+    } else if (opClass == OP_5XY2) {
+        int x = nibbleX(opcode);
+        int y = nibbleY(opcode);
+        length = (x <= y ? y - x : x - y) + 1;
+    } else {
+        return;
+    }
+    // writes past the end of memory wrap to the start
+    int size = memorySize();
+    int start = address & (size - 1);
+    blocks.invalidate(start, std::min(length, size - start));
+    if (start + length > size) {
+        blocks.invalidate(0, start + length - size);
+    }
+}
+
+void Chip8::runBlocks(int count) {
+    switch (profile) {
+#define CHIP8_PROFILE_CASE(name, flag) \
+    case QuirkProfile::name: runBlocksAs<QuirkProfile::name>(count); break;
+        CHIP8_QUIRK_PROFILES(CHIP8_PROFILE_CASE)
+#undef CHIP8_PROFILE_CASE
+    }
+}
+
+template <QuirkProfile P>
+void Chip8::runBlocksAs(int count) {
+    constexpr int mask = memorySizeOf(P) - 1;
+#if CHIP8_COMPUTED_GOTO
+    static void* const labels[OP_COUNT + 1] = {
+#define CHIP8_LABEL(name) &&L_##name,
+        CHIP8_OPCODES(CHIP8_LABEL)
+#undef CHIP8_LABEL
+        &&L_stop
+    };
+#endif
+    // block that ran last, whose successors are tried first
+    int previous = -1;
+    while (count > 0) {
+        // pc can run past the end of a 4 kB memory; fetches wrap but pc
+        // keeps its high bits, so that stretch is interpreted
+        if (pc > mask) {
+            step();
+            count--;
+            previous = -1;
+            continue;
+        }
+        TwoByte address = pc;
+        int index = previous < 0 ? -1 : blocks.successor(previous, address);
+        if (index < 0) {
+            index = blocks.find(address);
+            if (index < 0) {
+                if (blocks.full()) {
+                    blocks.clear();
+                    previous = -1;
+                }
+                index = compileBlock(address);
+            }
+            if (previous >= 0) {
+                blocks.link(previous, index);
+            }
+        }
+        Block& block = blocks[index];
+
+        // no room to translate at the end of RAM
+        if (block.instructions == 0) {
+            step();
+            count--;
+            previous = -1;
+            continue;
+        }
+
+        BlockOp* op = block.ops;
+        BlockOp* end = op + block.opCount;
+        // when the budget runs out partway through the block (or a fused
+        // op), that op is swapped for a stop marker while the block runs
+        BlockOp* stop = end;
+        uint8_t stopClass = BlockOp::stop;
+        if (block.instructions > count) {
+            stop = op + block.opOf[count];
+            stopClass = stop->opClass;
+            stop->opClass = BlockOp::stop;
+        }
+        // only the last op reads pc, and it follows the whole block
+        pc = block.exit;
+        TwoByte opcode;
+
+        // the handlers themselves, inlined; writes (at most 16 bytes)
+        // near code or wrapping past the end are checked, and one that
+        // replaces this block's own code leaves it at the next op
+#define CHIP8_BLOCK_OP(name) \
+        if constexpr (writesMemory(OP_##name)) { \
+            TwoByte written = i_reg & mask; \
+            op##name<P>(*this, opcode); \
+            if (blocks.nearCode(written) || written > mask - 16) { \
+                checkCodeWrite(OP_##name, opcode, written); \
+                if (!block.live) { \
+                    goto blockDone; \
+                } \
+            } \
+        } else { \
+            op##name<P>(*this, opcode); \
+        }
+#if CHIP8_COMPUTED_GOTO
+        // each op jumps straight to the next one
+#define CHIP8_DISPATCH() \
+        opcode = op->opcode; \
+        goto *labels[op++->opClass]
+
+        CHIP8_DISPATCH();
+#define CHIP8_THREADED(name) \
+    L_##name: CHIP8_BLOCK_OP(name) CHIP8_DISPATCH();
+        CHIP8_OPCODES(CHIP8_THREADED)
+#undef CHIP8_THREADED
+#undef CHIP8_DISPATCH
+    L_stop:
+        op--;
+#else
+        while (op->opClass != BlockOp::stop) {
+            opcode = op->opcode;
+            switch (op++->opClass) {
+#define CHIP8_CASE(name) case OP_##name: CHIP8_BLOCK_OP(name) break;
+                CHIP8_OPCODES(CHIP8_CASE)
+#undef CHIP8_CASE
+            default: break;
+            }
+        }
+#endif
+#undef CHIP8_BLOCK_OP
+
+    blockDone:
+        stop->opClass = stopClass;
+        if (op != end) {
+            pc = op->address;
+            count -= op->before;
+        } else {
+            count -= block.instructions;
+        }
+        if (!block.live) {
+            // retranslate from the instruction after the write
+            previous = -1;
+            continue;
+        }
+        if (op != end) {
+            // interpret what is left so frame timing stays exact
+            while (count-- > 0) {
+                step();
+            }
+            return;
+        }
+        previous = index;
+    }
+}
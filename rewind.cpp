@@ -0,0 +1,202 @@
+#include "rewind.h"
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+static_assert(std::is_trivially_copyable<Snapshot>::value,
+    "rewind treats snapshots as raw bytes");
+
+// room reserved per delta frame when sizing the arena
+static const size_t typical_delta_size = 256;
+
+namespace {
+
+// worst case for alternating zero / non-zero bytes
+size_t maxEncodedSize(size_t used) {
+    return used * 5 / 2 + 4;
+}
+
+// keyframes are XORed against all zero bytes, which a value-initialized
+// Snapshot is not (its std::mt19937 is seeded); stepBack rebuilds from
+// the same bytes
+const Byte zero_state[sizeof(Snapshot)] = {};
+
+void put16(Byte* out, size_t& pos, size_t value) {
+    out[pos++] = value & 0xFF;
+    out[pos++] = value >> 8;
+}
+
+size_t get16(const Byte* in, size_t& pos) {
+    size_t value = in[pos] | (in[pos + 1] << 8);
+    pos += 2;
+    return value;
+}
+
+// run-length encode a XOR b as (u16 zero run, u16 length, bytes) records
+size_t encodeXor(const Byte* a, const Byte* b, size_t size, Byte* out) {
+    size_t pos = 0;
+    size_t i = 0;
+    while (i < size) {
+        size_t zeros = i;
+        while (i < size && a[i] == b[i] && i - zeros < 0xFFFF) i++;
+        size_t literal = i;
+        while (i < size && a[i] != b[i] && i - literal < 0xFFFF) i++;
+        put16(out, pos, literal - zeros);
+        put16(out, pos, i - literal);
+        for (size_t j = literal; j < i; j++) {
+            out[pos++] = a[j] ^ b[j];
+        }
+    }
+    return pos;
+}
+
+}
+
+Rewind::Rewind(int seconds)
+    : entries(seconds * 60 > 0 ? seconds * 60 : 1), first(0), count(0),
+      head(0), sinceKey(0), stateSize(0), current(), next() {
+    // short histories need more frequent keyframes, since frames are
+    // evicted a keyframe group at a time
+    keyInterval = std::min<int>(keyframe_interval, 
+        std::max<int>(1, entries.size() / 4));
+}
+
+void Rewind::reserve(size_t used) {
+    size_t keyframes = entries.size() / keyInterval + 2;
+    scratch.assign(maxEncodedSize(used), 0);
+    arena.assign(entries.size() * typical_delta_size 
+        + keyframes * maxEncodedSize(used), 0);
+    stateSize = used;
+    clear();
+}
+
+void Rewind::clear() {
+    first = 0;
+    count = 0;
+    head = 0;
+    sinceKey = 0;
+}
+
+void Rewind::dropOldest() {
+    first = (first + 1) % entries.size();
+    count--;
+}
+
+void Rewind::makeRoom(size_t size) {
+    // wrap instead of splitting an entry across the end of the arena;
+    // entries past head are the oldest ones and go first
+    if (head + size > arena.size()) {
+        while (count > 0 && entry(0).offset >= head) {
+            dropOldest();
+        }
+        head = 0;
+    }
+    // evict entries the new one would overwrite
+    while (count > 0) {
+        const Entry& oldest = entry(0);
+        bool overlaps = oldest.offset < head + size 
+            && head < oldest.offset + oldest.size;
+        if (!overlaps && count < (int)entries.size()) {
+            break;
+        }
+        dropOldest();
+    }
+    // history must start at a keyframe to be decodable
+    while (count > 0 && !entry(0).key) {
+        dropOldest();
+    }
+}
+
+void Rewind::store(size_t size, bool key) {
+    std::memcpy(&arena[head], scratch.data(), size);
+    Entry& e = entry(count);
+    e.offset = head;
+    e.size = size;
+    e.key = key;
+    count++;
+    head += size;
+}
+
+void Rewind::push(const Chip8& chip8) {
+    chip8.save(next);
+    const Byte* now = (const Byte*)&next;
+    // only the used prefix is encoded, 4 kB of RAM for most profiles
+    size_t used = snapshotSize(next);
+    // the arena is sized for the profile's memory on the first frame; a
+    // new profile starts history over
+    if (used != stateSize) {
+        reserve(used);
+    }
+    bool key = count == 0 || sinceKey + 1 >= keyInterval;
+
+    // XOR against zeros stores the snapshot itself
+    const Byte* base = key ? zero_state : (const Byte*)&current;
+    size_t size = encodeXor(now, base, used, scratch.data());
+    makeRoom(size);
+    if (!key && count == 0) {
+        // everything was evicted, history has to restart at a keyframe
+        key = true;
+        size = encodeXor(now, zero_state, used, scratch.data());
+        makeRoom(size);
+    }
+    store(size, key);
+    sinceKey = key ? 0 : sinceKey + 1;
+    std::memcpy((void*)&current, &next, used);
+}
+
+void Rewind::apply(const Entry& e) {
+    Byte* state = (Byte*)&current;
+    const Byte* in = &arena[e.offset];
+    size_t pos = 0;
+    size_t at = 0;
+    while (pos < e.size) {
+        at += get16(in, pos);
+        size_t length = get16(in, pos);
+        for (size_t j = 0; j < length; j++) {
+            state[at++] ^= in[pos++];
+        }
+    }
+}
+
+bool Rewind::stepBack(Chip8& chip8) {
+    if (count < 2) {
+        return false;
+    }
+    const Entry& newest = entry(count - 1);
+    if (!newest.key) {
+        // XOR is its own inverse
+        apply(newest);
+    } else {
+        // rebuild from the previous keyframe
+        int k = count - 2;
+        while (k > 0 && !entry(k).key) k--;
+        if (!entry(k).key) {
+            return false;
+        }
+        std::memcpy((void*)&current, zero_state, sizeof(Snapshot));
+        for (int i = k; i < count - 1; i++) {
+            apply(entry(i));
+        }
+    }
+    count--;
+    head = newest.offset;
+    sinceKey = 0;
+    for (int i = count - 1; i > 0 && !entry(i).key; i--) {
+        sinceKey++;
+    }
+    chip8.restore(current);
+    return true;
+}
+
+size_t Rewind::bytesUsed() const {
+    size_t used = 0;
+    for (int i = 0; i < count; i++) {
+        used += entry(i).size;
+    }
+    return used;
+}
+
+double Rewind::bytesPerMinute() const {
+    return count == 0 ? 0 : (double)bytesUsed() / count * 60 * 60;
+}
@@ -0,0 +1,78 @@
+#ifndef REWIND_H
+#define REWIND_H
+
+#include <cstddef>
+#include <vector>
+
+#include "snapshot.h"
+
+// Rewind history: one entry per frame in a fixed byte arena. Most entries
+// are the XOR of a frame's snapshot with the previous one, run-length
+// encoded; at most every keyframe_interval frames a full snapshot is stored
+// instead. The arena and all scratch space are sized for the profile's
+// memory on the first frame, so recording a frame only allocates when the
+// profile changes. Oldest frames are dropped a whole keyframe group at a
+// time when the arena or frame limit is reached.
+class Rewind {
+public:
+    static constexpr int keyframe_interval = 60;
+
+    // keep up to seconds of 60Hz history
+    explicit Rewind(int seconds);
+
+    // record the machine state at the end of a frame
+    void push(const Chip8& chip8);
+    // go back one frame, dropping the newest; false if history is empty
+    bool stepBack(Chip8& chip8);
+    // forget all history (e.g. after loading a save state)
+    void clear();
+
+    // frames currently held
+    int frames() const { return count; }
+    // arena bytes used by held frames
+    size_t bytesUsed() const;
+    // average bytes of history per minute of play
+    double bytesPerMinute() const;
+
+private:
+    struct Entry {
+        size_t offset;
+        size_t size;
+        bool key;
+    };
+
+    Entry& entry(int i) { return entries[(first + i) % entries.size()]; }
+    const Entry& entry(int i) const {
+        return entries[(first + i) % entries.size()];
+    }
+    void dropOldest();
+    // evict old frames until an entry of size fits at head
+    void makeRoom(size_t size);
+    // copy the encoded entry in scratch into the arena
+    void store(size_t size, bool key);
+    // XOR an encoded entry into current
+    void apply(const Entry& e);
+    // size the arena and scratch for snapshots of used bytes
+    void reserve(size_t used);
+
+    std::vector<Byte> arena;
+    // ring of entries, oldest at first
+    std::vector<Entry> entries;
+    int first;
+    int count;
+    // next write position in arena
+    size_t head;
+    // frames since the last keyframe
+    int sinceKey;
+    // frames between keyframes
+    int keyInterval;
+    // encoded bytes of each snapshot, 0 before the first frame
+    size_t stateSize;
+
+    // state of the newest frame, and the frame being recorded
+    Snapshot current;
+    Snapshot next;
+    std::vector<Byte> scratch;
+};
+
+#endif
@@ -0,0 +1,237 @@
+#include "rom_database.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char rom_database_magic[4] = { 'C', 'H', '8', 'D' };
+static const size_t header_size = 4 + 2 + 2 + 4 + 4;
+static const size_t record_size = 8 + 2 + 1 + 1 + 16 + 4;
+
+namespace {
+
+uint64_t get(const uint8_t* in, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) {
+        value |= (uint64_t)in[i] << (8 * i);
+    }
+    return value;
+}
+
+void put(std::vector<uint8_t>& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out.push_back((value >> (8 * i)) & 0xFF);
+    }
+}
+
+}
+
+int RomDatabase::open(const char* path) {
+    close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        std::cerr << "ROM database could not be opened.\n";
+        return 1;
+    }
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(file, &fileSize);
+    size = (size_t)fileSize.QuadPart;
+    HANDLE mapping = size > 0
+        ? CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+    CloseHandle(file);
+    if (mapping == NULL) {
+        std::cerr << "ROM database could not be mapped.\n";
+        return 1;
+    }
+    handle = mapping;
+    data = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+    int file = ::open(path, O_RDONLY);
+    if (file < 0) {
+        std::cerr << "ROM database could not be opened.\n";
+        return 1;
+    }
+    struct stat info;
+    size = fstat(file, &info) == 0 ? (size_t)info.st_size : 0;
+    void* mapped = size > 0
+        ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, file, 0) : MAP_FAILED;
+    ::close(file);
+    data = mapped != MAP_FAILED ? (const uint8_t*)mapped : NULL;
+#endif
+    if (data == NULL) {
+        std::cerr << "ROM database could not be mapped.\n";
+        close();
+        return 1;
+    }
+
+    // only the header is checked, records are read on lookup
+    if (size < header_size
+            || std::memcmp(data, rom_database_magic, 4) != 0
+            || get(data + 4, 2) != rom_database_version
+            || get(data + 6, 2) != record_size) {
+        std::cerr << "Not a ROM database file.\n";
+        close();
+        return 1;
+    }
+    uint64_t records = get(data + 8, 4);
+    if (records > (size - header_size) / record_size) {
+        std::cerr << "ROM database is truncated.\n";
+        close();
+        return 1;
+    }
+    count = (int)records;
+    return 0;
+}
+
+void RomDatabase::close() {
+#ifdef _WIN32
+    if (data != NULL) UnmapViewOfFile(data);
+    if (handle != NULL) CloseHandle((HANDLE)handle);
+#else
+    if (data != NULL) munmap((void*)data, size);
+#endif
+    data = NULL;
+    handle = NULL;
+    size = 0;
+    count = 0;
+}
+
+bool RomDatabase::find(uint64_t hash, RomSettings& settings) const {
+    // binary search in the mapped records, touching O(log n) pages
+    int low = 0;
+    int high = count;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        uint64_t key = get(data + header_size + mid * record_size, 8);
+        if (key < hash) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    if (low == count) return false;
+    const uint8_t* record = data + header_size + low * record_size;
+    if (get(record, 8) != hash || record[10] >= quirk_profile_count) {
+        return false;
+    }
+    settings.instructionsPerFrame = get(record + 8, 2);
+    settings.profile = (QuirkProfile)record[10];
+    settings.hasKeymap = record[11] != 0;
+    std::memcpy(settings.keymap, record + 12, 16);
+    return true;
+}
+
+namespace {
+
+struct Entry {
+    uint64_t hash;
+    uint16_t instructionsPerFrame;
+    QuirkProfile profile;
+    bool hasKeymap;
+    char keymap[16];
+};
+
+bool parseEntry(const std::string& line, Entry& entry) {
+    std::istringstream fields {line};
+    std::string hash, quirks, speed, keys;
+    if (!(fields >> hash >> quirks >> speed >> keys)) {
+        return false;
+    }
+    char* end;
+    entry.hash = std::strtoull(hash.c_str(), &end, 16);
+    if (*end != '\0') return false;
+
+    entry.profile = QuirkProfile::CosmacVip;
+    if (quirks != "-" && !parseQuirkProfile(quirks.c_str(), entry.profile)) {
+        return false;
+    }
+    entry.instructionsPerFrame = 0;
+    if (speed != "-") {
+        long value = std::strtol(speed.c_str(), &end, 10);
+        if (*end != '\0' || value < 1 || value > 0xFFFF) return false;
+        entry.instructionsPerFrame = value;
+    }
+    entry.hasKeymap = keys != "-";
+    std::memset(entry.keymap, 0, sizeof(entry.keymap));
+    if (entry.hasKeymap) {
+        if (keys.size() != 16) return false;
+        for (int i = 0; i < 16; i++) {
+            char c = keys[i];
+            if (!((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9'))) {
+                return false;
+            }
+            entry.keymap[i] = c;
+        }
+    }
+    return true;
+}
+
+}
+
+int writeRomDatabase(const char* textPath, const char* path) {
+    std::ifstream text {textPath};
+    if (!text) {
+        std::cerr << "ROM list could not be opened.\n";
+        return 1;
+    }
+    std::vector<Entry> entries;
+    std::string line;
+    for (int number = 1; std::getline(text, line); number++) {
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') continue;
+        Entry entry;
+        if (!parseEntry(line, entry)) {
+            std::cerr << "ROM list line " << number << " is invalid.\n";
+            return 1;
+        }
+        entries.push_back(entry);
+    }
+    std::sort(entries.begin(), entries.end(),
+        [](const Entry& a, const Entry& b) { return a.hash < b.hash; });
+    for (size_t i = 1; i < entries.size(); i++) {
+        if (entries[i].hash == entries[i - 1].hash) {
+            std::cerr << "ROM list has a duplicate hash.\n";
+            return 1;
+        }
+    }
+
+    std::vector<uint8_t> out;
+    out.reserve(header_size + entries.size() * record_size);
+    out.insert(out.end(), rom_database_magic, rom_database_magic + 4);
+    put(out, rom_database_version, 2);
+    put(out, record_size, 2);
+    put(out, entries.size(), 4);
+    put(out, 0, 4);
+    for (const Entry& entry : entries) {
+        put(out, entry.hash, 8);
+        put(out, entry.instructionsPerFrame, 2);
+        put(out, (uint8_t)entry.profile, 1);
+        put(out, entry.hasKeymap, 1);
+        out.insert(out.end(), entry.keymap, entry.keymap + 16);
+        put(out, 0, 4);
+    }
+
+    std::ofstream file {path, std::ios::binary};
+    if (!file.write((const char*)out.data(), out.size())) {
+        std::cerr << "ROM database could not be written.\n";
+        return 1;
+    }
+    return 0;
+}
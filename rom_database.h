@@ -0,0 +1,61 @@
+#ifndef ROM_DATABASE_H
+#define ROM_DATABASE_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "quirks.h"
+
+// Per-ROM settings looked up by program hash (Chip8::hashProgram).
+//
+// The database file is a sorted index that is memory-mapped and binary
+// searched in place, so opening it reads nothing up front.
+//
+// file layout (little-endian):
+//   "CH8D" magic, u16 version, u16 record size, u32 record count,
+//   u32 reserved
+//   records sorted by hash, each:
+//     u64 hash, u16 instructions per frame (0 for the default),
+//     u8 quirk profile, u8 has key map, 16 x u8 key map, u32 reserved
+// The key map gives the host key for CHIP-8 keys 0-F as a lowercase
+// letter or digit.
+const uint16_t rom_database_version = 1;
+
+struct RomSettings {
+    QuirkProfile profile;
+    // 0 to keep the default speed
+    int instructionsPerFrame;
+    bool hasKeymap;
+    char keymap[16];
+};
+
+class RomDatabase {
+public:
+    RomDatabase() : data(NULL), size(0), count(0), handle(NULL) {}
+    ~RomDatabase() { close(); }
+    RomDatabase(const RomDatabase&) = delete;
+    RomDatabase& operator=(const RomDatabase&) = delete;
+
+    // map a database file, 1 on error
+    int open(const char* path);
+    void close();
+
+    // settings for a program hash, false if it is not listed
+    bool find(uint64_t hash, RomSettings& settings) const;
+    int entries() const { return count; }
+
+private:
+    const uint8_t* data;
+    size_t size;
+    int count;
+    // platform mapping handle
+    void* handle;
+};
+
+// build a database from a text file, one ROM per line:
+//   hash quirks ipf keymap
+// e.g. "7da144b97d054b25 schip 30 x123qweasdzc4rfv", "-" for a default.
+// Blank lines and lines starting with # are ignored. 1 on error.
+int writeRomDatabase(const char* textPath, const char* path);
+
+#endif
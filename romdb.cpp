@@ -0,0 +1,68 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include "chip8.h"
+#include "rom_database.h"
+
+// Builds the per-ROM settings database read by chip-8 --rom-db, and
+// prints ROM hashes for writing its source list.
+//
+//   chip-8-romdb list.txt roms.db   build roms.db from list.txt
+//   chip-8-romdb --hash rom...      print "hash path" for each ROM
+//   chip-8-romdb --find roms.db rom look a ROM up
+
+int printHashes(int count, char* paths[]) {
+    int result = EXIT_SUCCESS;
+    for (int i = 0; i < count; i++) {
+        std::vector<Byte> program;
+        if (Chip8::readProgram(paths[i], program) != 0) {
+            result = EXIT_FAILURE;
+            continue;
+        }
+        std::printf("%016llx %s\n", (unsigned long long)Chip8::hashProgram(
+            program.data(), program.size()), paths[i]);
+    }
+    return result;
+}
+
+int findRom(const char* databasePath, const char* path) {
+    RomDatabase database;
+    std::vector<Byte> program;
+    if (database.open(databasePath) != 0
+            || Chip8::readProgram(path, program) != 0) {
+        return EXIT_FAILURE;
+    }
+    RomSettings rom;
+    if (!database.find(Chip8::hashProgram(program.data(), program.size()),
+            rom)) {
+        std::printf("not listed\n");
+        return EXIT_FAILURE;
+    }
+    std::printf("quirks: %s\n", quirkProfileName(rom.profile));
+    if (rom.instructionsPerFrame > 0) {
+        std::printf("instructions per frame: %d\n", rom.instructionsPerFrame);
+    }
+    if (rom.hasKeymap) {
+        std::printf("keymap: %.16s\n", rom.keymap);
+    }
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char* args[]) {
+    if (argc >= 3 && std::strcmp(args[1], "--hash") == 0) {
+        return printHashes(argc - 2, args + 2);
+    }
+    if (argc == 4 && std::strcmp(args[1], "--find") == 0) {
+        return findRom(args[2], args[3]);
+    }
+    if (argc == 3 && args[1][0] != '-') {
+        return writeRomDatabase(args[1], args[2]) == 0
+            ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    std::cerr << "Usage: chip-8-romdb list.txt database\n"
+        "       chip-8-romdb --hash rom...\n"
+        "       chip-8-romdb --find database rom\n";
+    return EXIT_FAILURE;
+}
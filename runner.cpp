@@ -0,0 +1,246 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "chip8.h"
+#include "thread_pool.h"
+
+// Runs a corpus of ROMs headless in parallel and checks each final
+// framebuffer hash against a golden value.
+//
+// manifest format, one ROM per line (paths relative to the manifest):
+//   path [cycles [hash]]
+// a missing or "-" hash only reports the result. Blank lines and lines
+// starting with # are ignored.
+
+namespace fs = std::filesystem;
+
+struct RomCase {
+    std::string path;
+    long long cycles = 0;
+    bool hasGolden = false;
+    uint64_t golden = 0;
+    // results
+    bool loaded = false;
+    uint64_t hash = 0;
+    double seconds = 0;
+};
+
+// command line settings
+struct Options {
+    const char* corpus = NULL;
+    long long cycles = 1000000;
+    int threads = 0;
+    uint32_t seed = 1;
+    Chip8::Engine engine = Chip8::Engine::Threaded;
+    QuirkProfile profile = QuirkProfile::CosmacVip;
+    // write a manifest with the observed hashes
+    const char* write = NULL;
+};
+
+bool parseArgs(int argc, char* args[], Options& options) {
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (std::strcmp(args[i], "--cycles") == 0 && hasValue) {
+            options.cycles = std::atoll(args[++i]);
+        } else if (std::strcmp(args[i], "--frames") == 0 && hasValue) {
+            options.cycles = std::atoll(args[++i])
+                * Chip8::instructions_per_frame;
+        } else if (std::strcmp(args[i], "--threads") == 0 && hasValue) {
+            options.threads = std::atoi(args[++i]);
+        } else if (std::strcmp(args[i], "--seed") == 0 && hasValue) {
+            options.seed = std::strtoul(args[++i], NULL, 0);
+        } else if (std::strcmp(args[i], "--engine") == 0 && hasValue) {
+            i++;
+            if (std::strcmp(args[i], "table") == 0) {
+                options.engine = Chip8::Engine::Table;
+            } else if (std::strcmp(args[i], "threaded") == 0) {
+                options.engine = Chip8::Engine::Threaded;
+            } else if (std::strcmp(args[i], "blocks") == 0) {
+                options.engine = Chip8::Engine::Blocks;
+            } else {
+                return false;
+            }
+        } else if (std::strcmp(args[i], "--quirks") == 0 && hasValue) {
+            if (!parseQuirkProfile(args[++i], options.profile)) {
+                return false;
+            }
+        } else if (std::strcmp(args[i], "--write") == 0 && hasValue) {
+            options.write = args[++i];
+        } else if (options.corpus == NULL) {
+            options.corpus = args[i];
+        } else {
+            return false;
+        }
+    }
+    return options.corpus != NULL && options.cycles > 0;
+}
+
+// every .ch8 file in a directory, no golden values
+int listDirectory(const fs::path& dir, long long cycles,
+        std::vector<RomCase>& cases) {
+    std::error_code error;
+    for (const auto& file : fs::directory_iterator(dir, error)) {
+        if (file.is_regular_file() && file.path().extension() == ".ch8") {
+            RomCase rom;
+            rom.path = file.path().string();
+            rom.cycles = cycles;
+            cases.push_back(rom);
+        }
+    }
+    if (error) {
+        std::cerr << "ROM directory could not be read.\n";
+        return 1;
+    }
+    std::sort(cases.begin(), cases.end(),
+        [](const RomCase& a, const RomCase& b) { return a.path < b.path; });
+    return 0;
+}
+
+int readManifest(const fs::path& manifest, long long cycles,
+        std::vector<RomCase>& cases) {
+    std::ifstream file {manifest};
+    if (!file) {
+        std::cerr << "Manifest could not be opened.\n";
+        return 1;
+    }
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        std::istringstream fields {line};
+        std::string path, cyclesField, hashField;
+        if (!(fields >> path) || path[0] == '#') {
+            continue;
+        }
+        RomCase rom;
+        rom.path = (manifest.parent_path() / path).string();
+        rom.cycles = cycles;
+        if (fields >> cyclesField && cyclesField != "-") {
+            rom.cycles = std::atoll(cyclesField.c_str());
+        }
+        if (fields >> hashField && hashField != "-") {
+            rom.hasGolden = true;
+            rom.golden = std::strtoull(hashField.c_str(), NULL, 16);
+        }
+        if (rom.cycles <= 0) {
+            std::cerr << "Manifest line " << lineNumber
+                << ": invalid cycle count.\n";
+            return 1;
+        }
+        cases.push_back(rom);
+    }
+    return 0;
+}
+
+void runCase(const Chip8& prototype, RomCase& rom) {
+    Chip8 chip8 = prototype;
+    rom.loaded = chip8.loadProgram(rom.path.c_str()) == 0;
+    if (!rom.loaded) {
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (long long n = rom.cycles / chip8.instructionsPerFrame;
+            n > 0; n--) {
+        chip8.runFrame();
+    }
+    chip8.run(rom.cycles % chip8.instructionsPerFrame);
+    rom.seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    rom.hash = chip8.framebufferHash();
+}
+
+int main(int argc, char* args[]) {
+    Options options;
+    if (!parseArgs(argc, args, options)) {
+        std::cerr << "Usage: chip-8-runner [--cycles N | --frames N] "
+            "[--threads N] [--seed N]\n"
+            "                     [--engine table|threaded|blocks] "
+            "[--quirks vip|chip48|schip|xochip|amiga]\n"
+            "                     [--write manifest] [directory | manifest]\n";
+        return EXIT_FAILURE;
+    }
+
+    std::vector<RomCase> cases;
+    fs::path corpus {options.corpus};
+    int result = fs::is_directory(corpus)
+        ? listDirectory(corpus, options.cycles, cases)
+        : readManifest(corpus, options.cycles, cases);
+    if (result != 0) return EXIT_FAILURE;
+
+    // font and settings shared by every run
+    Chip8 prototype;
+    prototype.loadFont();
+    prototype.engine = options.engine;
+    prototype.profile = options.profile;
+    prototype.seed(options.seed);
+
+    auto start = std::chrono::steady_clock::now();
+    {
+        ThreadPool pool(options.threads);
+        for (RomCase& rom : cases) {
+            pool.submit([&prototype, &rom] { runCase(prototype, rom); });
+        }
+        pool.wait();
+    }
+    double elapsed = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+
+    int passed = 0, failed = 0, unchecked = 0;
+    long long totalCycles = 0;
+    for (const RomCase& rom : cases) {
+        const char* status;
+        if (!rom.loaded) {
+            status = "ERROR";
+            failed++;
+        } else if (!rom.hasGolden) {
+            status = "RAN";
+            unchecked++;
+        } else if (rom.hash == rom.golden) {
+            status = "PASS";
+            passed++;
+        } else {
+            status = "FAIL";
+            failed++;
+        }
+        if (rom.loaded) {
+            totalCycles += rom.cycles;
+            std::printf("%-5s %016llx %10.1f Minstr/s  %s\n", status,
+                (unsigned long long)rom.hash,
+                rom.seconds > 0 ? rom.cycles / rom.seconds / 1e6 : 0.0,
+                rom.path.c_str());
+        } else {
+            std::printf("%-5s %16s %19s  %s\n", status, "-", "",
+                rom.path.c_str());
+        }
+    }
+    std::printf("%d passed, %d failed, %d unchecked, %zu ROMs in %.2f s "
+        "(%.1f Minstr/s total)\n", passed, failed, unchecked, cases.size(),
+        elapsed, elapsed > 0 ? totalCycles / elapsed / 1e6 : 0.0);
+
+    if (options.write != NULL) {
+        std::ofstream manifest {options.write};
+        fs::path base = fs::absolute(options.write).parent_path();
+        for (const RomCase& rom : cases) {
+            if (!rom.loaded) continue;
+            char hash[17];
+            std::snprintf(hash, sizeof(hash), "%016llx",
+                (unsigned long long)rom.hash);
+            manifest << fs::relative(fs::absolute(rom.path), base)
+                .generic_string() << ' ' << rom.cycles << ' '
+                << hash << '\n';
+        }
+        if (!manifest) {
+            std::cerr << "Manifest could not be written.\n";
+            return EXIT_FAILURE;
+        }
+    }
+    return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,80 @@
+#include "screen_renderer.h"
+
+#include <cstring>
+
+// pixel colors by plane bits (XRGB8888), plane 0 alone is plain white
+static const Uint32 palette[16] = {
+    0xFF000000, 0xFFFFFFFF, 0xFFAAAAAA, 0xFF555555,
+    0xFFFF0000, 0xFF00FF00, 0xFF0000FF, 0xFFFFFF00,
+    0xFF880000, 0xFF008800, 0xFF000088, 0xFF888800,
+    0xFFFF00FF, 0xFF00FFFF, 0xFF880088, 0xFF008888
+};
+
+ScreenRenderer::ScreenRenderer(SDL_Renderer* renderer)
+    : renderer(renderer), lastWidth(0), lastHeight(0), dirty(true) {
+    // sized for the largest resolution, smaller modes use the top left
+    texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_XRGB8888,
+        SDL_TEXTUREACCESS_STREAMING, 
+        Framebuffer::max_width, Framebuffer::max_height);
+    if (texture == NULL) {
+        SDL_Log("Texture could not be created! SDL_Error: %s\n",
+            SDL_GetError());
+    } else {
+        SDL_SetTextureScaleMode(texture, SDL_SCALEMODE_NEAREST);
+    }
+}
+
+ScreenRenderer::~ScreenRenderer() {
+    SDL_DestroyTexture(texture);
+}
+
+void ScreenRenderer::upload(const Framebuffer& pixels) {
+    SDL_Rect area = { 0, 0, pixels.width, pixels.height };
+    void* data;
+    int pitch;
+    if (!SDL_LockTexture(texture, &area, &data, &pitch)) {
+        return;
+    }
+    pixels.expand((Uint32*)data, pitch, palette);
+    SDL_UnlockTexture(texture);
+}
+
+void ScreenRenderer::setOverlay(const std::string& text) {
+    if (text != overlay) {
+        overlay = text;
+        dirty = true;
+    }
+}
+
+void ScreenRenderer::present(const Framebuffer& pixels) {
+    bool changed = pixels.width != lastWidth || pixels.height != lastHeight
+        || std::memcmp(lastPlanes, pixels.planes, sizeof(lastPlanes)) != 0;
+    if (!changed && !dirty) {
+        return;
+    }
+    if (changed) {
+        upload(pixels);
+        std::memcpy(lastPlanes, pixels.planes, sizeof(lastPlanes));
+        lastWidth = pixels.width;
+        lastHeight = pixels.height;
+    }
+    dirty = false;
+
+    // one scaled copy to fill the window
+    SDL_FRect src = { 0, 0, (float)pixels.width, (float)pixels.height };
+    SDL_RenderTexture(renderer, texture, &src, NULL);
+
+    // 8x8 debug font, top left
+    if (!overlay.empty()) {
+        SDL_SetRenderDrawColor(renderer, 0xFF, 0xC0, 0x00, 0xFF);
+        size_t start = 0;
+        for (float y = 4; start < overlay.size(); y += 10) {
+            size_t end = overlay.find('\n', start);
+            if (end == std::string::npos) end = overlay.size();
+            SDL_RenderDebugText(renderer, 4, y,
+                overlay.substr(start, end - start).c_str());
+            start = end + 1;
+        }
+    }
+    SDL_RenderPresent(renderer);
+}
@@ -0,0 +1,38 @@
+#ifndef SCREEN_RENDERER_H
+#define SCREEN_RENDERER_H
+
+#include <SDL3/SDL.h>
+
+#include <string>
+
+#include "framebuffer.h"
+
+// Draws the framebuffer through a streaming texture: one upload and one
+// scaled copy per frame, and nothing at all when the screen is unchanged.
+class ScreenRenderer {
+public:
+    explicit ScreenRenderer(SDL_Renderer* renderer);
+    ~ScreenRenderer();
+
+    // upload and present the framebuffer if it changed since last present
+    void present(const Framebuffer& pixels);
+    // force the next present (e.g. window was exposed or resized)
+    void invalidate() { dirty = true; }
+    // text drawn over the screen, one line per newline, empty for none
+    void setOverlay(const std::string& text);
+
+private:
+    void upload(const Framebuffer& pixels);
+
+    SDL_Renderer* renderer;
+    SDL_Texture* texture;
+    // contents of the last presented frame
+    uint64_t lastPlanes[Framebuffer::max_planes][Framebuffer::max_height]
+        [Framebuffer::words_per_row];
+    int lastWidth;
+    int lastHeight;
+    bool dirty;
+    std::string overlay;
+};
+
+#endif
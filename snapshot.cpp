@@ -0,0 +1,292 @@
+#include "snapshot.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <vector>
+
+// file layout (little-endian):
+//   "CH8S" magic, u16 version
+//   u8 quirk profile, u16 instructions per frame
+//   u16 pc, u16 I, u8 sp, 16 x u16 stack, 16 x u8 V0-VF
+//   u8 delay timer, u8 sound timer, i8 last key, u16 key bitmask
+//   u16 width, u16 height, u8 plane mask,
+//   4 x height x (width / 64) x u64 pixel rows
+//   u32 n, n x u8 RAM (4096, or 65536 for XO-CHIP)
+//   16 x u8 RPL flags, 16 x u8 audio pattern, u8 pitch
+//   u16 n, n x u32 PRNG state words
+// version 3 files (no profile or speed), version 2 files (also always
+// 65536 bytes of RAM, no length) and version 1 files (4 kB RAM, one
+// plane, no SUPER-CHIP / XO-CHIP state) are still read.
+static const char snapshot_magic[4] = { 'C', 'H', '8', 'S' };
+
+void Chip8::save(Snapshot& snapshot) const {
+    snapshot.ramSize = memorySize();
+    std::memcpy(snapshot.ram.data(), ram.data(), snapshot.ramSize);
+    snapshot.stack = stack;
+    snapshot.registers = registers;
+    snapshot.keys = keys;
+    snapshot.pc = pc;
+    snapshot.i_reg = i_reg;
+    snapshot.sp = sp;
+    snapshot.dTimer = dTimer;
+    snapshot.sTimer = sTimer;
+    snapshot.lastKey = lastKey;
+    snapshot.width = pixels.width;
+    snapshot.height = pixels.height;
+    snapshot.planeMask = pixels.planeMask;
+    std::memcpy(snapshot.planes, pixels.planes, sizeof(snapshot.planes));
+    snapshot.flags = flags;
+    snapshot.audioPattern = audioPattern;
+    snapshot.pitch = pitch;
+    snapshot.mt = mt;
+    snapshot.profile = (uint8_t)profile;
+    snapshot.instructionsPerFrame = instructionsPerFrame;
+}
+
+void Chip8::restore(const Snapshot& snapshot) {
+    // the profile decides how much memory there is, so it goes first
+    if (snapshot.profile < quirk_profile_count) {
+        profile = (QuirkProfile)snapshot.profile;
+    }
+    if (snapshot.instructionsPerFrame > 0) {
+        instructionsPerFrame = snapshot.instructionsPerFrame;
+    }
+    // memory the snapshot doesn't cover starts out clear
+    size_t used = std::min<size_t>(snapshot.ramSize, ram.size());
+    std::memcpy(ram.data(), snapshot.ram.data(), used);
+    if ((int)used < memorySize()) {
+        std::fill(ram.begin() + used, ram.begin() + memorySize(), 0);
+    }
+    stack = snapshot.stack;
+    registers = snapshot.registers;
+    keys = snapshot.keys;
+    pc = snapshot.pc;
+    i_reg = snapshot.i_reg;
+    sp = snapshot.sp & 0xF;
+    dTimer = snapshot.dTimer;
+    sTimer = snapshot.sTimer;
+    lastKey = snapshot.lastKey;
+    pixels.setResolution(snapshot.width, snapshot.height);
+    pixels.planeMask = snapshot.planeMask;
+    std::memcpy(pixels.planes, snapshot.planes, sizeof(pixels.planes));
+    flags = snapshot.flags;
+    audioPattern = snapshot.audioPattern;
+    pitch = snapshot.pitch;
+    mt = snapshot.mt;
+    // RAM was replaced wholesale
+    blocks.clear();
+}
+
+namespace {
+
+void put8(std::vector<Byte>& out, Byte value) {
+    out.push_back(value);
+}
+
+void put16(std::vector<Byte>& out, uint16_t value) {
+    out.push_back(value & 0xFF);
+    out.push_back(value >> 8);
+}
+
+void put32(std::vector<Byte>& out, uint32_t value) {
+    put16(out, value & 0xFFFF);
+    put16(out, value >> 16);
+}
+
+void put64(std::vector<Byte>& out, uint64_t value) {
+    put32(out, value & 0xFFFFFFFF);
+    put32(out, value >> 32);
+}
+
+// bounds-checked reader over a loaded file
+struct Reader {
+    const std::vector<Byte>& in;
+    size_t pos;
+    bool ok;
+
+    bool has(size_t n) {
+        ok = ok && pos + n <= in.size();
+        return ok;
+    }
+    Byte get8() {
+        return has(1) ? in[pos++] : 0;
+    }
+    uint16_t get16() {
+        uint16_t lo = get8();
+        return lo | (get8() << 8);
+    }
+    uint32_t get32() {
+        uint32_t lo = get16();
+        return lo | ((uint32_t)get16() << 16);
+    }
+    uint64_t get64() {
+        uint64_t lo = get32();
+        return lo | ((uint64_t)get32() << 32);
+    }
+};
+
+}
+
+int writeSnapshot(const Snapshot& snapshot, const char* path) {
+    std::vector<Byte> out;
+    out.reserve(snapshotSize(snapshot));
+    out.insert(out.end(), snapshot_magic, snapshot_magic + 4);
+    put16(out, snapshot_version);
+    put8(out, snapshot.profile);
+    put16(out, snapshot.instructionsPerFrame);
+
+    put16(out, snapshot.pc);
+    put16(out, snapshot.i_reg);
+    put8(out, snapshot.sp);
+    for (TwoByte entry : snapshot.stack) put16(out, entry);
+    for (Byte v : snapshot.registers) put8(out, v);
+    put8(out, snapshot.dTimer);
+    put8(out, snapshot.sTimer);
+    put8(out, (Byte)snapshot.lastKey);
+    uint16_t keyMask = 0;
+    for (int i = 0; i < 16; i++) {
+        keyMask |= snapshot.keys[i] << i;
+    }
+    put16(out, keyMask);
+
+    put16(out, snapshot.width);
+    put16(out, snapshot.height);
+    put8(out, snapshot.planeMask);
+    for (int p = 0; p < Framebuffer::max_planes; p++) {
+        for (int y = 0; y < snapshot.height; y++) {
+            for (int w = 0; w < snapshot.width / 64; w++) {
+                put64(out, snapshot.planes[p][y][w]);
+            }
+        }
+    }
+    put32(out, snapshot.ramSize);
+    out.insert(out.end(), snapshot.ram.begin(),
+        snapshot.ram.begin() + snapshot.ramSize);
+    out.insert(out.end(), snapshot.flags.begin(), snapshot.flags.end());
+    out.insert(out.end(), snapshot.audioPattern.begin(),
+        snapshot.audioPattern.end());
+    put8(out, snapshot.pitch);
+
+    // the standard only exposes engine state as text
+    std::stringstream prng;
+    prng << snapshot.mt;
+    std::vector<uint32_t> words { std::istream_iterator<uint32_t>(prng),
+        std::istream_iterator<uint32_t>() };
+    put16(out, words.size());
+    for (uint32_t word : words) put32(out, word);
+
+    std::ofstream file {path, std::ios::binary};
+    if (!file.write((const char*)out.data(), out.size())) {
+        std::cerr << "Save state could not be written.\n";
+        return 1;
+    }
+    return 0;
+}
+
+int readSnapshot(Snapshot& snapshot, const char* path) {
+    std::ifstream file {path, std::ios::binary};
+    if (!file) {
+        std::cerr << "Save state could not be opened.\n";
+        return 1;
+    }
+    std::vector<Byte> in { std::istreambuf_iterator<char>(file),
+        std::istreambuf_iterator<char>() };
+    Reader reader { in, 4, true };
+
+    if (in.size() < 6 || std::memcmp(in.data(), snapshot_magic, 4) != 0) {
+        std::cerr << "Not a save state file.\n";
+        return 1;
+    }
+    uint16_t version = reader.get16();
+    if (version < 1 || version > snapshot_version) {
+        std::cerr << "Unsupported save state version.\n";
+        return 1;
+    }
+
+    Snapshot loaded {};
+    loaded.profile = quirk_profile_count;
+    if (version >= 4) {
+        loaded.profile = reader.get8();
+        loaded.instructionsPerFrame = reader.get16();
+        if (reader.ok && loaded.profile >= quirk_profile_count) {
+            std::cerr << "Save state has an invalid quirk profile.\n";
+            return 1;
+        }
+    }
+    // version 1 predates planes, 64 kB RAM and the extension registers
+    bool extended = version >= 2;
+    int planes = extended ? Framebuffer::max_planes : 1;
+    loaded.pc = reader.get16();
+    loaded.i_reg = reader.get16();
+    loaded.sp = reader.get8();
+    for (TwoByte& entry : loaded.stack) entry = reader.get16();
+    for (Byte& v : loaded.registers) v = reader.get8();
+    loaded.dTimer = reader.get8();
+    loaded.sTimer = reader.get8();
+    loaded.lastKey = (int8_t)reader.get8();
+    uint16_t keyMask = reader.get16();
+    for (int i = 0; i < 16; i++) {
+        loaded.keys[i] = (keyMask >> i) & 1;
+    }
+
+    loaded.width = reader.get16();
+    loaded.height = reader.get16();
+    if (!(loaded.width == 64 && loaded.height == 32)
+            && !(loaded.width == 128 && loaded.height == 64)) {
+        std::cerr << "Save state has an invalid resolution.\n";
+        return 1;
+    }
+    loaded.planeMask = extended ? reader.get8() : 1;
+    for (int p = 0; p < planes; p++) {
+        for (int y = 0; y < loaded.height; y++) {
+            for (int w = 0; w < loaded.width / 64; w++) {
+                loaded.planes[p][y][w] = reader.get64();
+            }
+        }
+    }
+    // version 2 always stored 64 kB, version 3 stores what was used
+    loaded.ramSize = version == 1 ? 4096
+        : version == 2 ? loaded.ram.size() : reader.get32();
+    if (reader.ok && loaded.ramSize != 4096
+            && loaded.ramSize != loaded.ram.size()) {
+        std::cerr << "Save state has an invalid memory size.\n";
+        return 1;
+    }
+    if (reader.has(loaded.ramSize)) {
+        std::memcpy(loaded.ram.data(), &in[reader.pos], loaded.ramSize);
+        reader.pos += loaded.ramSize;
+    }
+    if (version == 2 && std::all_of(loaded.ram.begin() + 4096,
+            loaded.ram.end(), [](Byte b) { return b == 0; })) {
+        // only XO-CHIP addresses past 4 kB
+        loaded.ramSize = 4096;
+    }
+    loaded.pitch = 64;
+    if (extended) {
+        for (Byte& flag : loaded.flags) flag = reader.get8();
+        for (Byte& b : loaded.audioPattern) b = reader.get8();
+        loaded.pitch = reader.get8();
+    }
+
+    std::stringstream prng;
+    for (uint16_t n = reader.get16(); n > 0; n--) {
+        prng << reader.get32() << ' ';
+    }
+    prng >> loaded.mt;
+
+    if (!reader.ok || !prng) {
+        std::cerr << "Save state is truncated or corrupt.\n";
+        return 1;
+    }
+    snapshot = loaded;
+    return 0;
+}
+
+bool snapshotFits(const Snapshot& snapshot, const Chip8& chip8) {
+    return snapshot.profile < quirk_profile_count
+        || snapshot.ramSize == (uint32_t)chip8.memorySize();
+}
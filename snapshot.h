@@ -0,0 +1,60 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <array>
+#include <cstddef>
+#include <random>
+
+#include "chip8.h"
+
+// Complete machine state in fixed-size storage. Taking or restoring one
+// is a handful of copies and never allocates, so it is cheap enough to do
+// every frame. Only the RAM the profile addresses is copied, and RAM is
+// last so a snapshot's used bytes are one prefix (snapshotSize).
+struct Snapshot {
+    std::array<TwoByte, 16> stack;
+    std::array<Byte, 16> registers;
+    std::array<bool, 16> keys;
+    TwoByte pc;
+    TwoByte i_reg;
+    Byte sp;
+    Byte dTimer;
+    Byte sTimer;
+    int8_t lastKey;
+    // framebuffer resolution, selected planes and packed rows
+    uint16_t width;
+    uint16_t height;
+    uint8_t planeMask;
+    uint64_t planes[Framebuffer::max_planes][Framebuffer::max_height]
+        [Framebuffer::words_per_row];
+    std::array<Byte, 16> flags;
+    std::array<Byte, 16> audioPattern;
+    Byte pitch;
+    std::mt19937 mt;
+    // quirk profile and speed the state was saved with, applied on
+    // restore; quirk_profile_count and 0 for files that predate them
+    uint8_t profile;
+    uint16_t instructionsPerFrame;
+    // bytes of ram in use, 4 kB or 64 kB for XO-CHIP
+    uint32_t ramSize;
+    std::array<Byte, 65536> ram;
+};
+
+// bytes from the start of a snapshot to the end of its used RAM
+inline size_t snapshotSize(const Snapshot& snapshot) {
+    return (const Byte*)snapshot.ram.data() - (const Byte*)&snapshot
+        + snapshot.ramSize;
+}
+
+// save state file format version, bump when the layout changes
+const uint16_t snapshot_version = 4;
+
+// write a snapshot to a versioned binary file
+int writeSnapshot(const Snapshot& snapshot, const char* path);
+// read a snapshot written by writeSnapshot
+int readSnapshot(Snapshot& snapshot, const char* path);
+// whether chip8 can restore a snapshot: one without a profile must have
+// been saved with the same memory size
+bool snapshotFits(const Snapshot& snapshot, const Chip8& chip8);
+
+#endif
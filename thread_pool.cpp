@@ -0,0 +1,103 @@
+#include "thread_pool.h"
+
+// index of the worker running on this thread, -1 outside the pool
+static thread_local int worker_index = -1;
+static thread_local const ThreadPool* worker_pool = nullptr;
+
+ThreadPool::ThreadPool(int threads) 
+    : nextQueue(0), pending(0), stopping(false) {
+    if (threads <= 0) {
+        threads = std::thread::hardware_concurrency();
+        if (threads <= 0) threads = 1;
+    }
+    for (int i = 0; i < threads; i++) {
+        queues.emplace_back(new Queue);
+    }
+    for (int i = 0; i < threads; i++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        stopping = true;
+    }
+    taskAvailable.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    // tasks spawned by a worker stay local, others are spread round robin
+    int index = worker_pool == this ? worker_index 
+        : (int)(nextQueue++ % queues.size());
+    {
+        // under the state lock so an idle worker can't miss the wakeup
+        std::lock_guard<std::mutex> lock(stateMutex);
+        pending++;
+        std::lock_guard<std::mutex> queueLock(queues[index]->mutex);
+        queues[index]->tasks.push_back(std::move(task));
+    }
+    taskAvailable.notify_one();
+}
+
+bool ThreadPool::takeTask(int index, std::function<void()>& task) {
+    // own queue, newest first
+    {
+        Queue& own = *queues[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    // steal the oldest task of another worker
+    for (size_t n = 1; n < queues.size(); n++) {
+        Queue& other = *queues[(index + n) % queues.size()];
+        std::lock_guard<std::mutex> lock(other.mutex);
+        if (!other.tasks.empty()) {
+            task = std::move(other.tasks.front());
+            other.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::workerLoop(int index) {
+    worker_index = index;
+    worker_pool = this;
+    std::function<void()> task;
+    while (true) {
+        if (takeTask(index, task)) {
+            task();
+            task = nullptr;
+            std::lock_guard<std::mutex> lock(stateMutex);
+            if (--pending == 0) {
+                allDone.notify_all();
+            }
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(stateMutex);
+        if (stopping) {
+            return;
+        }
+        // recheck under the lock so a submit can't slip past us
+        bool queued = false;
+        for (auto& queue : queues) {
+            std::lock_guard<std::mutex> queueLock(queue->mutex);
+            queued = queued || !queue->tasks.empty();
+        }
+        if (!queued) {
+            taskAvailable.wait(lock);
+        }
+    }
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(stateMutex);
+    allDone.wait(lock, [this] { return pending == 0; });
+}
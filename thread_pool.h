@@ -0,0 +1,55 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads, each with its own task deque. Workers take
+// their newest task first and, when idle, steal the oldest task from
+// another worker, so uneven tasks (e.g. ROMs of very different length)
+// still keep every core busy.
+class ThreadPool {
+public:
+    // threads <= 0 uses one worker per hardware thread
+    explicit ThreadPool(int threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(std::function<void()> task);
+    // block until every submitted task has finished
+    void wait();
+
+    int size() const { return (int)workers.size(); }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void workerLoop(int index);
+    bool takeTask(int index, std::function<void()>& task);
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    // next queue for tasks submitted from outside the pool
+    std::atomic<unsigned> nextQueue;
+
+    // sleeping workers and wait() block on this
+    std::mutex stateMutex;
+    std::condition_variable taskAvailable;
+    std::condition_variable allDone;
+    // tasks submitted but not yet finished
+    int pending;
+    bool stopping;
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+#include <cstdint>
+
+// Single producer, single consumer handoff of the latest value without
+// locks. The writer fills its back slot and publishes it by swapping it
+// with the shared middle slot; the reader swaps the middle slot into its
+// front slot when a new value is there. Neither side ever waits, and a
+// value the reader did not pick up in time is simply overwritten.
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() : back(0), front(2), middle(1) {}
+
+    // writer: slot to fill, then publish()
+    T& write() { return slots[back].value; }
+    void publish() {
+        back = middle.exchange(back | fresh, std::memory_order_acq_rel)
+            & index_mask;
+    }
+
+    // reader: take the newest published value, false if nothing new
+    bool update() {
+        if ((middle.load(std::memory_order_relaxed) & fresh) == 0) {
+            return false;
+        }
+        front = middle.exchange(front, std::memory_order_acq_rel)
+            & index_mask;
+        return true;
+    }
+    // the value taken by the last successful update()
+    const T& read() const { return slots[front].value; }
+
+private:
+    static const uint8_t index_mask = 3;
+    // middle slot holds a value the reader has not taken yet
+    static const uint8_t fresh = 4;
+
+    // own cache line each, the two threads write different slots
+    struct alignas(64) Slot {
+        T value;
+    };
+
+    Slot slots[3];
+    // writer only
+    uint8_t back;
+    // reader only
+    uint8_t front;
+    alignas(64) std::atomic<uint8_t> middle;
+};
+
+#endif